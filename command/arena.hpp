@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+namespace command {
+
+// Memory for command trees. CommandBuilder and GroupBuilder take an optional
+// std::pmr::memory_resource that the flags, their names and docs, and the
+// command objects are allocated from. With a monotonic_buffer_resource a large
+// tree is built with a handful of allocations and released all at once. The
+// resource must outlive every Cmd built from it.
+using MemoryResource = std::pmr::memory_resource;
+
+inline MemoryResource* default_resource()
+{
+  return std::pmr::get_default_resource();
+}
+
+template <class T> struct ArenaDeleter {
+ public:
+  void operator()(T* ptr) const
+  {
+    ptr->~T();
+    resource->deallocate(ptr, sizeof(T), alignof(T));
+  }
+
+  MemoryResource* resource;
+};
+
+// Allocates a T and its shared_ptr control block from resource. construct
+// receives the uninitialized memory and must placement-new the object in it,
+// which lets types with private constructors use it from their factories.
+template <class T, class F>
+std::shared_ptr<T> make_shared_in(MemoryResource* resource, F&& construct)
+{
+  void* mem = resource->allocate(sizeof(T), alignof(T));
+  T* obj;
+  try {
+    obj = construct(mem);
+  } catch (...) {
+    resource->deallocate(mem, sizeof(T), alignof(T));
+    throw;
+  }
+  return std::shared_ptr<T>(
+    obj,
+    ArenaDeleter<T>{resource},
+    std::pmr::polymorphic_allocator<T>(resource));
+}
+
+} // namespace command
@@ -0,0 +1,313 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <thread>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "command_builder.hpp"
+#include "io_util.hpp"
+
+#include "bee/print.hpp"
+
+namespace command {
+namespace {
+
+// Invocations that finished but can't be emitted yet keep their output files
+// open, this bounds how far ahead of the oldest running one workers can get.
+constexpr size_t lookahead_per_job = 16;
+
+bee::OrError<> copy_to(int from, int to)
+{
+  char buffer[1 << 16];
+  for (off_t offset = 0;;) {
+    ssize_t n = pread(from, buffer, sizeof(buffer), offset);
+    if (n == -1) {
+      if (errno == EINTR) { continue; }
+      return bee::Error::fmt("Failed to read output: $", strerror(errno));
+    }
+    if (n == 0) { return bee::ok(); }
+    offset += n;
+    for (ssize_t written = 0; written < n;) {
+      ssize_t w = write(to, buffer + written, n - written);
+      if (w == -1) {
+        if (errno == EINTR) { continue; }
+        return bee::Error::fmt("Failed to write output: $", strerror(errno));
+      }
+      written += w;
+    }
+  }
+}
+
+struct Worker {
+ public:
+  pid_t pid = -1;
+  // Becomes readable when the process exits, -1 if the kernel has no pidfds
+  int pidfd = -1;
+  int out = -1;
+  int err = -1;
+  std::optional<int> exit_code;
+
+  void close_files()
+  {
+    if (out != -1) { close(out); }
+    if (err != -1) { close(err); }
+    out = err = -1;
+  }
+};
+
+[[noreturn]] void run_in_child(
+  const Cmd& cmd, const Batch::Invocation& invocation, const Worker& worker)
+{
+  dup2(worker.out, STDOUT_FILENO);
+  dup2(worker.err, STDERR_FILENO);
+  int exit_code;
+  try {
+    exit_code = cmd.execute(
+      bee::LogOutput::StdErr,
+      bee::ArrayView<const std::string>(
+        invocation.args.data(), invocation.args.size()));
+  } catch (const std::exception& exn) {
+    PF(bee::LogOutput::StdErr, "Application exited with error:");
+    PF(bee::LogOutput::StdErr, exn.what());
+    exit_code = 1;
+  }
+  io_util::flush_output();
+  _exit(exit_code);
+}
+
+bee::OrError<> start(
+  const Cmd& cmd, const Batch::Invocation& invocation, Worker& worker)
+{
+  worker.out = memfd_create("batch-stdout", MFD_CLOEXEC);
+  worker.err = memfd_create("batch-stderr", MFD_CLOEXEC);
+  if (worker.out == -1 || worker.err == -1) {
+    int err = errno;
+    worker.close_files();
+    return bee::Error::fmt("Failed to create output file: $", strerror(err));
+  }
+
+  // Anything still buffered would otherwise be written again by the child
+  io_util::flush_output();
+  worker.pid = fork();
+  if (worker.pid == -1) {
+    int err = errno;
+    worker.close_files();
+    return bee::Error::fmt("Failed to fork: $", strerror(err));
+  }
+  if (worker.pid == 0) { run_in_child(cmd, invocation, worker); }
+  worker.pidfd = syscall(SYS_pidfd_open, worker.pid, 0);
+  return bee::ok();
+}
+
+int exit_code_of_status(int status)
+{
+  if (WIFEXITED(status)) { return WEXITSTATUS(status); }
+  if (WIFSIGNALED(status)) { return 128 + WTERMSIG(status); }
+  return 1;
+}
+
+// Blocks until at least one of the running workers exits and reaps the ones
+// that did. Only the workers' own pids are waited for, children the host
+// process forked for its own purposes are left alone.
+bee::OrError<> reap(std::vector<Worker>& workers, std::vector<size_t>& running)
+{
+  std::vector<pollfd> fds;
+  fds.reserve(running.size());
+  for (size_t idx : running) {
+    if (workers[idx].pidfd == -1) {
+      fds.clear();
+      break;
+    }
+    fds.push_back(
+      {.fd = workers[idx].pidfd, .events = POLLIN, .revents = 0});
+  }
+
+  int flags = WNOHANG;
+  if (fds.empty()) {
+    // Without pidfds, block on the worker whose output is needed first
+    flags = 0;
+  } else if (poll(fds.data(), fds.size(), -1) == -1) {
+    if (errno == EINTR) { return bee::ok(); }
+    return bee::Error::fmt("Failed to wait for worker: $", strerror(errno));
+  }
+
+  for (size_t i = 0; i < running.size();) {
+    auto& worker = workers[running[i]];
+    int status;
+    pid_t pid = waitpid(worker.pid, &status, flags);
+    if (pid == -1) {
+      if (errno == EINTR) { return bee::ok(); }
+      return bee::Error::fmt("Failed to wait for worker: $", strerror(errno));
+    }
+    if (pid == 0) {
+      i++;
+      continue;
+    }
+    worker.exit_code = exit_code_of_status(status);
+    if (worker.pidfd != -1) { close(worker.pidfd); }
+    worker.pidfd = -1;
+    running.erase(running.begin() + i);
+    if (flags == 0) { break; }
+  }
+  return bee::ok();
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// Batch
+//
+
+bee::OrError<std::vector<Batch::Invocation>> Batch::parse(
+  const std::string_view& content)
+{
+  std::vector<Invocation> invocations;
+  size_t line = 0;
+  for (size_t begin = 0; begin < content.size();) {
+    line++;
+    size_t end = content.find('\n', begin);
+    if (end == std::string_view::npos) { end = content.size(); }
+    std::string_view text = content.substr(begin, end - begin);
+    begin = end + 1;
+
+    std::vector<std::string> args;
+    for (size_t i = 0; i < text.size();) {
+      char c = text[i];
+      if (c == ' ' || c == '\t' || c == '\r') {
+        i++;
+        continue;
+      }
+      std::string arg;
+      if (c == '"') {
+        for (i++; i < text.size() && text[i] != '"'; i++) {
+          if (
+            text[i] == '\\' && i + 1 < text.size() &&
+            (text[i + 1] == '"' || text[i + 1] == '\\')) {
+            i++;
+          }
+          arg += text[i];
+        }
+        if (i == text.size()) {
+          return bee::Error::fmt("Line $: Unterminated quoted argument", line);
+        }
+        i++;
+      } else {
+        while (i < text.size() && text[i] != ' ' && text[i] != '\t' &&
+               text[i] != '\r') {
+          arg += text[i++];
+        }
+      }
+      args.push_back(std::move(arg));
+    }
+    if (!args.empty()) {
+      invocations.push_back({.line = line, .args = std::move(args)});
+    }
+  }
+  return invocations;
+}
+
+bee::OrError<std::vector<Batch::Result>> Batch::run(
+  const Cmd& cmd, const std::vector<Invocation>& invocations, size_t jobs)
+{
+  jobs = std::max<size_t>(jobs, 1);
+  const size_t lookahead = jobs * lookahead_per_job;
+
+  std::vector<Worker> workers(invocations.size());
+  // Indices of the workers still running, oldest first
+  std::vector<size_t> running;
+  std::vector<Result> results;
+  results.reserve(invocations.size());
+
+  auto wait_all = [&]() {
+    for (size_t idx : running) {
+      waitpid(workers[idx].pid, nullptr, 0);
+      if (workers[idx].pidfd != -1) { close(workers[idx].pidfd); }
+      workers[idx].close_files();
+    }
+  };
+
+  size_t next_start = 0;
+  while (results.size() < invocations.size()) {
+    while (running.size() < jobs && next_start < invocations.size() &&
+           next_start < results.size() + lookahead) {
+      auto& worker = workers[next_start];
+      auto err = start(cmd, invocations[next_start], worker);
+      if (err.is_error()) {
+        wait_all();
+        return err.error();
+      }
+      running.push_back(next_start++);
+    }
+
+    auto& oldest = workers[results.size()];
+    if (oldest.exit_code.has_value()) {
+      // Stdout of the parent may be a buffered writer, the captured output
+      // goes around it
+      io_util::flush_output();
+      auto err = copy_to(oldest.out, STDOUT_FILENO);
+      if (!err.is_error()) { err = copy_to(oldest.err, STDERR_FILENO); }
+      oldest.close_files();
+      if (err.is_error()) {
+        wait_all();
+        return err.error();
+      }
+      results.push_back({
+        .line = invocations[results.size()].line,
+        .exit_code = *oldest.exit_code,
+      });
+      continue;
+    }
+
+    auto err = reap(workers, running);
+    if (err.is_error()) {
+      wait_all();
+      return err.error();
+    }
+  }
+  return results;
+}
+
+Cmd batch_command(const Cmd& target, MemoryResource* resource)
+{
+  auto builder = CommandBuilder(
+    "Runs the command given on each line of a file", resource);
+  auto path = builder.required_anon(flags::String, "file");
+  auto jobs = builder.optional_with_default(
+    "--jobs",
+    flags::Int,
+    int(std::max(std::thread::hardware_concurrency(), 1u)),
+    "count",
+    "Maximum number of invocations running at once");
+  return builder.run([=]() -> bee::OrError<> {
+    if (*jobs < 1) { return bee::Error("--jobs must be at least 1"); }
+    bail(content, io_util::read_file(*path));
+    bail(invocations, Batch::parse(content));
+    bail(results, Batch::run(target, invocations, *jobs));
+
+    size_t failed = 0;
+    for (const auto& result : results) {
+      PF(
+        bee::LogOutput::StdErr,
+        "line $: exit code $",
+        result.line,
+        result.exit_code);
+      if (result.exit_code != 0) { failed++; }
+    }
+    if (failed > 0) {
+      return bee::Error::fmt(
+        "$ of $ invocations failed", failed, results.size());
+    }
+    return bee::ok();
+  });
+}
+
+} // namespace command
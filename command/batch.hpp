@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "cmd.hpp"
+
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Runs one invocation of a command per line of a file. Arguments on a line are
+// separated by spaces or tabs, an argument that starts with a double quote
+// extends to the matching quote (with \" and \\ unescaped) and blank lines are
+// skipped.
+//
+// Each invocation runs in its own process forked from the current one, up to
+// `jobs` at once, so the command tree is only built once and state a handler
+// leaves behind doesn't leak into the next line. The output of each invocation
+// is captured and written to stdout and stderr in the order of the lines,
+// regardless of the order they finish.
+//
+// Forking is unsafe in a multithreaded process: the children only get the
+// calling thread, and locks other threads held at the time of the fork, the
+// allocator's and stdio's included, stay locked in them forever. A host that
+// embeds the command tree next to threads of its own, see invoke.hpp, must run
+// batches before starting them or from a process that has none, or the
+// invocations can deadlock.
+struct Batch {
+ public:
+  struct Invocation {
+    size_t line;
+    std::vector<std::string> args;
+  };
+
+  struct Result {
+    size_t line;
+    int exit_code;
+  };
+
+  static bee::OrError<std::vector<Invocation>> parse(
+    const std::string_view& content);
+
+  static bee::OrError<std::vector<Result>> run(
+    const Cmd& cmd, const std::vector<Invocation>& invocations, size_t jobs);
+};
+
+// A command that runs target for each line of the file given as its argument
+// and prints an exit status summary to stderr. It fails if any invocation
+// fails. GroupBuilder::batch adds one that runs commands of the group itself.
+Cmd batch_command(
+  const Cmd& target, MemoryResource* resource = default_resource());
+
+} // namespace command
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "batch.hpp"
+#include "command_builder.hpp"
+#include "group_builder.hpp"
+#include "invoke.hpp"
+
+#include "bee/format_vector.hpp"
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace command {
+namespace {
+
+Cmd make_app()
+{
+  auto builder = CommandBuilder("Greets");
+  auto name = builder.required("--name", flags::String);
+  auto delay = builder.optional_with_default("--delay-ms", flags::Int, 0);
+  auto greet = builder.run([=]() -> bee::OrError<> {
+    std::this_thread::sleep_for(std::chrono::milliseconds(*delay));
+    P("Hello $", *name);
+    if (*name == "nobody") { return bee::Error("Nobody to greet"); }
+    return bee::ok();
+  });
+  return GroupBuilder("App").cmd("greet", greet).batch().build();
+}
+
+void run_batch(const Cmd& app, const string& content, const string& jobs)
+{
+  P("content:\n$", content);
+  {
+    std::ofstream file("batch_test.txt");
+    file << content;
+  }
+  vector<string_view> args = {"batch", "batch_test.txt", "--jobs", jobs};
+  auto result =
+    invoke(app, bee::ArrayView<const string_view>(args)).value();
+  P("exit_code: $", result.exit_code);
+  P("out:\n$", result.out);
+  P("err:\n$", result.err);
+  P("------------------------------------");
+  std::remove("batch_test.txt");
+}
+
+TEST(parse)
+{
+  auto run = [](const string_view& content) {
+    auto invocations = Batch::parse(content);
+    if (invocations.is_error()) {
+      P("Error: $", invocations.error());
+      return;
+    }
+    for (const auto& invocation : *invocations) {
+      P("$: $", invocation.line, invocation.args);
+    }
+    P("------------------------------------");
+  };
+  run("greet --name world\n\ngreet  --name\tagain\r\n");
+  run("greet --name \"two words\" --other \"\" \"say \\\"hi\\\"\"");
+  run("greet --name \"unterminated\n");
+}
+
+TEST(batch)
+{
+  auto app = make_app();
+  // Earlier lines take longer, but output still comes out in line order
+  run_batch(
+    app,
+    "greet --name first --delay-ms 60\n"
+    "greet --name second --delay-ms 30\n"
+    "\n"
+    "greet --name third\n",
+    "3");
+  run_batch(app, "greet --name world\ngreet --name nobody\ngreet\n", "2");
+  run_batch(app, "greet --name \"oops\n", "1");
+}
+
+TEST(leaves_other_children_alone)
+{
+  // A child of the host that exits while the batch runs
+  pid_t child = fork();
+  if (child == 0) { _exit(7); }
+
+  auto app = make_app();
+  run_batch(app, "greet --name a --delay-ms 50\ngreet --name b\n", "2");
+
+  int status;
+  P("host child reaped by host: $", waitpid(child, &status, 0) == child);
+  P("host child exit code: $", WEXITSTATUS(status));
+}
+
+} // namespace
+} // namespace command
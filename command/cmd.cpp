@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "command_base.hpp"
+#include "completion.hpp"
 
 #include "bee/array_view.hpp"
 #include "bee/log_output.hpp"
@@ -18,18 +19,31 @@ int Cmd::main(
   const char* const* const argv,
   const bee::LogOutput log_output) const
 {
-  std::vector<std::string> args;
-  for (int i = 1; i < argc; i++) { args.push_back(argv[i]); }
-  return execute(log_output, args);
+  std::vector<std::string_view> args;
+  if (argc > 1) { args.reserve(argc - 1); }
+  for (int i = 1; i < argc; i++) { args.emplace_back(argv[i]); }
+  auto view = bee::ArrayView<const std::string_view>(args);
+  if (!args.empty() && args.front() == complete_command) {
+    return complete_and_cache(*_base, view.slice(1));
+  }
+  return execute(log_output, view);
 }
 
 int Cmd::execute(
   const bee::LogOutput log_output,
-  const bee::ArrayView<const std::string> flags) const
+  const bee::ArrayView<const std::string_view> flags) const
 {
   return _base->execute(log_output, flags);
 }
 
-const std::string& Cmd::description() const { return _base->description(); }
+int Cmd::execute(
+  const bee::LogOutput log_output,
+  const bee::ArrayView<const std::string> flags) const
+{
+  std::vector<std::string_view> args(flags.begin(), flags.end());
+  return execute(log_output, bee::ArrayView<const std::string_view>(args));
+}
+
+std::string_view Cmd::description() const { return _base->description(); }
 
 } // namespace command
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <string_view>
 
 #include "bee/array_view.hpp"
 #include "bee/log_output.hpp"
@@ -17,12 +19,26 @@ struct Cmd {
   Cmd(const Cmd& other) = default;
   Cmd(Cmd&& other) = default;
 
+  // Arguments are passed to the command as views of argv, which must stay
+  // alive while the command runs. A first argument of __complete answers a
+  // shell completion request instead, see completion.hpp.
   int main(
     int argc,
     const char* const* argv,
     bee::LogOutput log_output = bee::LogOutput::StdErr) const;
 
-  const std::string& description() const;
+  // Views the description kept by the command, valid while it is alive.
+  std::string_view description() const;
+
+  // The command behind this Cmd, for code that inspects a tree, e.g. to
+  // flatten nested groups.
+  const CommandBase* base() const { return _base.get(); }
+
+  // The arguments are only viewed, the strings they point to must outlive the
+  // call.
+  int execute(
+    bee::LogOutput log_output,
+    bee::ArrayView<const std::string_view> flags) const;
   int execute(
     bee::LogOutput log_output, bee::ArrayView<const std::string> flags) const;
 
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace command {
+
+// Append-only columnar storage for the values of a repeated flag. Values are
+// kept in a single packed array, and strings are stored back to back in one
+// byte buffer indexed by an array of offsets instead of as separate heap
+// allocated std::strings.
+template <class T> struct Column {
+ public:
+  using value_type = T;
+  using const_iterator = typename std::vector<T>::const_iterator;
+
+  void push_back(T value) { _values.push_back(std::move(value)); }
+
+  size_t size() const { return _values.size(); }
+  bool empty() const { return _values.empty(); }
+
+  const T& operator[](size_t index) const { return _values[index]; }
+
+  const_iterator begin() const { return _values.begin(); }
+  const_iterator end() const { return _values.end(); }
+
+  // Heap memory used by the column, in bytes.
+  size_t memory_usage() const { return _values.capacity() * sizeof(T); }
+
+ private:
+  std::vector<T> _values;
+};
+
+template <> struct Column<std::string> {
+ public:
+  using value_type = std::string_view;
+
+  struct const_iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::string_view;
+
+    const_iterator() = default;
+
+    std::string_view operator*() const { return (*_column)[_index]; }
+    std::string_view operator[](difference_type n) const
+    {
+      return (*_column)[_index + n];
+    }
+
+    const_iterator& operator++()
+    {
+      _index++;
+      return *this;
+    }
+    const_iterator operator++(int)
+    {
+      auto it = *this;
+      _index++;
+      return it;
+    }
+    const_iterator& operator--()
+    {
+      _index--;
+      return *this;
+    }
+    const_iterator operator--(int)
+    {
+      auto it = *this;
+      _index--;
+      return it;
+    }
+    const_iterator& operator+=(difference_type n)
+    {
+      _index += n;
+      return *this;
+    }
+    const_iterator& operator-=(difference_type n)
+    {
+      _index -= n;
+      return *this;
+    }
+    const_iterator operator+(difference_type n) const
+    {
+      return const_iterator(_column, _index + n);
+    }
+    friend const_iterator operator+(difference_type n, const const_iterator& it)
+    {
+      return it + n;
+    }
+    const_iterator operator-(difference_type n) const
+    {
+      return const_iterator(_column, _index - n);
+    }
+    difference_type operator-(const const_iterator& other) const
+    {
+      return difference_type(_index) - difference_type(other._index);
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return _index == other._index;
+    }
+    auto operator<=>(const const_iterator& other) const
+    {
+      return _index <=> other._index;
+    }
+
+   private:
+    friend struct Column;
+    const_iterator(const Column* column, size_t index)
+        : _column(column), _index(index)
+    {}
+
+    const Column* _column = nullptr;
+    size_t _index = 0;
+  };
+
+  void push_back(const std::string_view& value)
+  {
+    _data.append(value);
+    _offsets.push_back(_data.size());
+  }
+
+  size_t size() const { return _offsets.size() - 1; }
+  bool empty() const { return size() == 0; }
+
+  std::string_view operator[](size_t index) const
+  {
+    size_t begin = _offsets[index];
+    return std::string_view(_data).substr(begin, _offsets[index + 1] - begin);
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
+
+  // Heap memory used by the column, in bytes.
+  size_t memory_usage() const
+  {
+    return _data.capacity() + _offsets.capacity() * sizeof(size_t);
+  }
+
+ private:
+  std::string _data;
+  std::vector<size_t> _offsets = {0};
+};
+
+} // namespace command
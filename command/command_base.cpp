@@ -1,13 +1,86 @@
 #include "command_base.hpp"
 
+#include <exception>
+
+#include "profile.hpp"
+
+#include "bee/file_writer.hpp"
+#include "bee/print.hpp"
+
 namespace command {
+namespace {
+
+thread_local CommandBase::ErrorCapture* current_capture = nullptr;
 
-CommandBase::CommandBase(const std::string_view& description)
-    : _description(description)
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// FlagValueError
+//
+
+FlagValueError::FlagValueError(const bee::Error& error)
+    : _error(error), _what(error.full_msg())
 {}
 
+const char* FlagValueError::what() const noexcept { return _what.c_str(); }
+
+////////////////////////////////////////////////////////////////////////////////
+// CommandBase
+//
+
+CommandBase::CommandBase(
+  const std::string_view& description, std::pmr::memory_resource* resource)
+    : _description(description, resource)
+{
+  Profiler::note_construction();
+}
+
 CommandBase::~CommandBase() {}
 
-const std::string& CommandBase::description() const { return _description; }
+std::string_view CommandBase::description() const { return _description; }
+
+void CommandBase::describe(CompletionTree&) const {}
+
+CommandBase::ErrorCapture::ErrorCapture() : _previous(current_capture)
+{
+  current_capture = this;
+}
+
+CommandBase::ErrorCapture::~ErrorCapture() { current_capture = _previous; }
+
+void CommandBase::record_error(const bee::Error& error)
+{
+  if (current_capture != nullptr && !current_capture->_error.has_value()) {
+    current_capture->_error.emplace(error);
+  }
+}
+
+int CommandBase::run_handler(
+  const bee::LogOutput log_output,
+  const std::function<bee::OrError<>()>& handler)
+{
+  auto err = [&]() -> bee::OrError<> {
+    Profiler::Span span("handler");
+    try {
+      return handler();
+    } catch (const FlagValueError& err) {
+      std::ignore = bee::FileWriter::stdout().flush();
+      return err.error();
+    } catch (const bee::Exn& err) {
+      std::ignore = bee::FileWriter::stdout().flush();
+      return bee::Error(err);
+    } catch (const std::exception& err) {
+      std::ignore = bee::FileWriter::stdout().flush();
+      throw;
+    }
+  }();
+  if (err.is_error()) {
+    record_error(err.error());
+    PF(log_output, "Application exited with error:");
+    PF(log_output, err.error().full_msg());
+    return 1;
+  }
+  return 0;
+}
 
 } // namespace command
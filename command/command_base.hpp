@@ -1,26 +1,112 @@
 #pragma once
 
+#include <exception>
+#include <functional>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "bee/array_view.hpp"
 #include "bee/log_output.hpp"
+#include "bee/or_error.hpp"
 
 namespace command {
 
+// Thrown by flag accessors when a value that was parsed lazily turns out to be
+// invalid. run_handler reports it like an error returned by the handler.
+struct FlagValueError : public std::exception {
+ public:
+  explicit FlagValueError(const bee::Error& error);
+
+  const bee::Error& error() const { return _error; }
+
+  virtual const char* what() const noexcept override;
+
+ private:
+  bee::Error _error;
+  std::string _what;
+};
+
+// The subcommands and flags accepted by a command, used to build the shell
+// completion index, see completion.hpp.
+struct CompletionTree {
+ public:
+  struct Flag {
+   public:
+    std::string name;
+    // Set for flags that take a value
+    std::optional<std::string> value_name;
+  };
+
+  struct Subcommand;
+
+  std::vector<Flag> flags;
+  std::vector<Subcommand> subcommands;
+
+  // Files the tree was read from at startup, e.g. a schema or a plugin
+  // manifest. A cached index is stale once one of them changes.
+  std::vector<std::string> inputs;
+};
+
+struct CompletionTree::Subcommand {
+ public:
+  std::string name;
+  CompletionTree tree;
+};
+
 struct CommandBase {
  public:
-  CommandBase(const std::string_view& description);
+  CommandBase(
+    const std::string_view& description,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
   virtual ~CommandBase();
 
   virtual int execute(
     bee::LogOutput log_output,
-    bee::ArrayView<const std::string> flags) const = 0;
+    bee::ArrayView<const std::string_view> flags) const = 0;
+
+  // Views the description, which lives in the command's memory resource.
+  std::string_view description() const;
+
+  // Adds what the command accepts to tree. Commands that don't override it
+  // complete nothing.
+  virtual void describe(CompletionTree& tree) const;
+
+  // While alive, records the first error reported by a command on this thread,
+  // e.g. a parsing error or the error returned by a handler.
+  struct ErrorCapture {
+   public:
+    ErrorCapture();
+    ~ErrorCapture();
 
-  const std::string& description() const;
+    ErrorCapture(const ErrorCapture&) = delete;
+    ErrorCapture& operator=(const ErrorCapture&) = delete;
+
+    const std::optional<bee::Error>& error() const { return _error; }
+
+   private:
+    friend struct CommandBase;
+
+    std::optional<bee::Error> _error;
+    ErrorCapture* _previous;
+  };
+
+  // Hands error to the current ErrorCapture, if any. Commands call it for the
+  // errors that make them exit with a failure.
+  static void record_error(const bee::Error& error);
+
+ protected:
+  // Runs a command handler, reporting errors through log_output. Returns the
+  // process exit code.
+  static int run_handler(
+    bee::LogOutput log_output,
+    const std::function<bee::OrError<>()>& handler);
 
  private:
-  std::string _description;
+  std::pmr::string _description;
 };
 
 } // namespace command
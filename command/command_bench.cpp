@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "command_builder.hpp"
+#include "group_builder.hpp"
+#include "static_command.hpp"
+
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+
+using std::string;
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocation tracking
+//
+
+namespace {
+
+std::atomic<size_t> num_allocations = 0;
+std::atomic<ptrdiff_t> live_bytes = 0;
+
+void* track_alloc(size_t size, size_t alignment = alignof(std::max_align_t))
+{
+  void* ptr = alignment <= alignof(std::max_align_t)
+                ? std::malloc(size == 0 ? 1 : size)
+                : std::aligned_alloc(
+                    alignment, (size + alignment - 1) / alignment * alignment);
+  if (ptr == nullptr) { throw std::bad_alloc(); }
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  live_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+  return ptr;
+}
+
+void track_free(void* ptr)
+{
+  if (ptr == nullptr) { return; }
+  live_bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+  std::free(ptr);
+}
+
+} // namespace
+
+void* operator new(size_t size) { return track_alloc(size); }
+void* operator new[](size_t size) { return track_alloc(size); }
+void operator delete(void* ptr) noexcept { track_free(ptr); }
+void operator delete[](void* ptr) noexcept { track_free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { track_free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { track_free(ptr); }
+
+// std::pmr::new_delete_resource allocates with the aligned overloads.
+void* operator new(size_t size, std::align_val_t align)
+{
+  return track_alloc(size, size_t(align));
+}
+void* operator new[](size_t size, std::align_val_t align)
+{
+  return track_alloc(size, size_t(align));
+}
+void operator delete(void* ptr, std::align_val_t) noexcept { track_free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+  track_free(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+  track_free(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+  track_free(ptr);
+}
+
+namespace command {
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// Harness
+//
+
+constexpr size_t repetitions = 5;
+
+struct Measurement {
+  std::chrono::nanoseconds wall;
+  std::chrono::nanoseconds wall_min;
+  size_t allocations;
+  ptrdiff_t retained_bytes;
+};
+
+// Runs fn a few times and reports its median wall time and the number of
+// allocations it made on the last run. fn returns the number of bytes it
+// retained at the point of interest.
+template <class F> Measurement measure(F&& fn)
+{
+  vector<std::chrono::nanoseconds> walls;
+  Measurement out{};
+  for (size_t i = 0; i < repetitions; i++) {
+    size_t allocs_before = num_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    ptrdiff_t retained = fn();
+    auto end = std::chrono::steady_clock::now();
+    out.allocations = num_allocations.load() - allocs_before;
+    out.retained_bytes = retained;
+    walls.push_back(end - start);
+  }
+  std::sort(walls.begin(), walls.end());
+  out.wall = walls[walls.size() / 2];
+  out.wall_min = walls.front();
+  return out;
+}
+
+// One JSON object per line, so runs of two versions can be diffed or loaded
+// side by side.
+void report(const string& name, size_t n, const Measurement& m)
+{
+  P("{\"name\":\"$\",\"n\":$,\"wall_ns\":$,\"wall_min_ns\":$,"
+    "\"allocations\":$,\"retained_bytes\":$}",
+    name,
+    n,
+    m.wall.count(),
+    m.wall_min.count(),
+    m.allocations,
+    m.retained_bytes);
+}
+
+vector<string> make_string_args(size_t n)
+{
+  vector<string> args;
+  args.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    args.push_back(F("/some/directory/file_$.txt", i));
+  }
+  return args;
+}
+
+// Sends stdout and stderr to /dev/null while alive, so help output doesn't
+// drown the report.
+struct Silence {
+ public:
+  Silence()
+  {
+    fflush(nullptr);
+    int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    for (int fd : {1, 2}) {
+      _saved[fd - 1] = dup(fd);
+      dup2(null, fd);
+    }
+    close(null);
+  }
+
+  ~Silence()
+  {
+    fflush(nullptr);
+    for (int fd : {1, 2}) {
+      dup2(_saved[fd - 1], fd);
+      close(_saved[fd - 1]);
+    }
+  }
+
+  Silence(const Silence&) = delete;
+  Silence& operator=(const Silence&) = delete;
+
+ private:
+  int _saved[2];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmarks
+//
+
+template <class MakeFlag>
+void bench_repeated_anon(
+  const string& name, const vector<string>& args, MakeFlag make_flag)
+{
+  auto m = measure([&]() -> ptrdiff_t {
+    ptrdiff_t before = live_bytes.load();
+    ptrdiff_t retained = 0;
+    auto builder = CommandBuilder("Bench");
+    auto flag = make_flag(builder);
+    auto cmd = builder.run([&]() {
+      retained = live_bytes.load() - before;
+      return bee::ok();
+    });
+    cmd.execute(bee::LogOutput::StdErr, bee::ArrayView<const string>(args));
+    return retained;
+  });
+  report(name, args.size(), m);
+}
+
+void bench_repeated_anon_storage(size_t n)
+{
+  auto args = make_string_args(n);
+  bench_repeated_anon("repeated_anon/vector", args, [](auto& builder) {
+    return builder.repeated_anon(flags::String, "files");
+  });
+  bench_repeated_anon("repeated_anon/columnar", args, [](auto& builder) {
+    return builder.repeated_anon_columnar(flags::String, "files");
+  });
+  bench_repeated_anon("repeated_anon/string_view", args, [](auto& builder) {
+    return builder.repeated_anon(flags::StringView, "files");
+  });
+}
+
+void bench_repeated_anon_numeric(size_t n)
+{
+  vector<string> ints;
+  vector<string> floats;
+  ints.reserve(n);
+  floats.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    ints.push_back(F(i * 7919 % 100000000));
+    floats.push_back(F(double(i) / 64));
+  }
+  bench_repeated_anon("repeated_anon/int", ints, [](auto& builder) {
+    return builder.repeated_anon(flags::Int, "ints");
+  });
+  bench_repeated_anon("repeated_anon/float", floats, [](auto& builder) {
+    return builder.repeated_anon(flags::Float, "floats");
+  });
+}
+
+struct TreeShape {
+  vector<string> group_names;
+  vector<string> command_names;
+  vector<string> flag_names;
+};
+
+TreeShape make_tree_shape(
+  size_t num_groups, size_t num_commands, size_t flags_per_command)
+{
+  TreeShape shape;
+  for (size_t i = 0; i < num_groups; i++) {
+    shape.group_names.push_back(F("group-$", i));
+  }
+  for (size_t i = 0; i < num_commands; i++) {
+    shape.command_names.push_back(F("command-$", i));
+  }
+  for (size_t i = 0; i < flags_per_command; i++) {
+    shape.flag_names.push_back(F("--generated-flag-$", i));
+  }
+  return shape;
+}
+
+// Builds a generated CLI where every group has the same commands and every
+// command has the same flags.
+Cmd build_tree(MemoryResource* resource, const TreeShape& shape)
+{
+  GroupBuilder root("Root", resource);
+  for (const auto& group_name : shape.group_names) {
+    GroupBuilder group("Generated group", resource);
+    for (const auto& command_name : shape.command_names) {
+      CommandBuilder builder("Generated command", resource);
+      for (const auto& flag_name : shape.flag_names) {
+        builder.optional(
+          flag_name,
+          flags::String,
+          "value",
+          "Documentation of a generated flag");
+      }
+      group.cmd(command_name, builder.run([]() { return bee::ok(); }));
+    }
+    root.cmd(group_name, group.build());
+  }
+  return root.build();
+}
+
+// Builds and tears down the tree, n is the total number of flags.
+void bench_build_tree()
+{
+  auto shape = make_tree_shape(50, 20, 8);
+  size_t n = shape.group_names.size() * shape.command_names.size() *
+             shape.flag_names.size();
+
+  auto m = measure([&]() -> ptrdiff_t {
+    build_tree(default_resource(), shape);
+    return 0;
+  });
+  report("build_tree/default", n, m);
+
+  m = measure([&]() -> ptrdiff_t {
+    std::pmr::monotonic_buffer_resource arena;
+    build_tree(&arena, shape);
+    return 0;
+  });
+  report("build_tree/arena", n, m);
+}
+
+// Parses num_args of num_flags optional flags, n is the number of flags
+// given.
+void bench_parse_args(size_t num_flags, size_t num_args)
+{
+  auto builder = CommandBuilder("Bench");
+  for (size_t i = 0; i < num_flags; i++) {
+    builder.optional(F("--flag-$", i), flags::String, "value");
+  }
+  auto cmd = builder.run([]() { return bee::ok(); });
+
+  // Spread over the declared flags, so lookups don't all hit the same one
+  vector<string> args;
+  for (size_t i = 0; i < num_args; i++) {
+    args.push_back(F("--flag-$", i * num_flags / num_args));
+    args.push_back(F("value-$", i));
+  }
+  auto m = measure([&]() -> ptrdiff_t {
+    cmd.execute(bee::LogOutput::StdErr, bee::ArrayView<const string>(args));
+    return 0;
+  });
+  report(F("parse_args/flags=$/args=$", num_flags, num_args), num_args, m);
+}
+
+namespace sf = static_flags;
+
+// The same eight flags the generated trees give every command, declared at
+// compile time.
+auto static_generated_command()
+{
+  return StaticCommandBuilder(
+           "Generated command",
+           sf::optional<"--generated-flag-0">(flags::String, "value"),
+           sf::optional<"--generated-flag-1">(flags::String, "value"),
+           sf::optional<"--generated-flag-2">(flags::String, "value"),
+           sf::optional<"--generated-flag-3">(flags::String, "value"),
+           sf::optional<"--generated-flag-4">(flags::String, "value"),
+           sf::optional<"--generated-flag-5">(flags::String, "value"),
+           sf::optional<"--generated-flag-6">(flags::String, "value"),
+           sf::optional<"--generated-flag-7">(flags::String, "value"))
+    .run([](const auto&) { return bee::ok(); });
+}
+
+// parse_args/flags=8/args=8 with a static command, n is the number of flags
+// given.
+void bench_static_parse_args()
+{
+  auto cmd = static_generated_command();
+  vector<string> args;
+  for (size_t i = 0; i < 8; i++) {
+    args.push_back(F("--generated-flag-$", i));
+    args.push_back(F("value-$", i));
+  }
+  auto m = measure([&]() -> ptrdiff_t {
+    cmd.execute(bee::LogOutput::StdErr, bee::ArrayView<const string>(args));
+    return 0;
+  });
+  report("static/parse_args/flags=8/args=8", 8, m);
+}
+
+// A chain of depth groups, each with width children of which the last one
+// leads deeper. Dispatches to the deepest command, n is the depth.
+void bench_dispatch(size_t depth, size_t width)
+{
+  auto leaf = []() {
+    return CommandBuilder("Leaf").run([]() { return bee::ok(); });
+  };
+  vector<string> names;
+  for (size_t i = 0; i < width; i++) { names.push_back(F("child-$", i)); }
+
+  std::function<Cmd(size_t)> make_level = [&](size_t level) {
+    if (level == depth) { return leaf(); }
+    GroupBuilder group("Level");
+    for (size_t i = 0; i + 1 < width; i++) { group.cmd(names[i], leaf()); }
+    group.cmd(names.back(), make_level(level + 1));
+    return group.build();
+  };
+  auto cmd = make_level(0);
+  vector<string> args(depth, names.back());
+
+  // The first dispatch builds the group's index, leave it out
+  cmd.execute(bee::LogOutput::StdErr, bee::ArrayView<const string>(args));
+  auto m = measure([&]() -> ptrdiff_t {
+    cmd.execute(bee::LogOutput::StdErr, bee::ArrayView<const string>(args));
+    return 0;
+  });
+  report(F("dispatch/depth=$/width=$", depth, width), depth, m);
+}
+
+// n is the number of lines printed.
+void bench_print_help()
+{
+  auto wide = make_tree_shape(1000, 1, 1);
+  auto wide_tree = build_tree(default_resource(), wide);
+  vector<string> group_help = {"help"};
+  auto m = measure([&]() -> ptrdiff_t {
+    Silence silence;
+    wide_tree.execute(
+      bee::LogOutput::StdOut, bee::ArrayView<const string>(group_help));
+    return 0;
+  });
+  report("print_help/group", wide.group_names.size(), m);
+
+  auto flagged = make_tree_shape(1, 1, 1000);
+  auto flagged_tree = build_tree(default_resource(), flagged);
+  vector<string> command_help = {
+    flagged.group_names[0], flagged.command_names[0], "--help"};
+  m = measure([&]() -> ptrdiff_t {
+    Silence silence;
+    flagged_tree.execute(
+      bee::LogOutput::StdOut, bee::ArrayView<const string>(command_help));
+    return 0;
+  });
+  report("print_help/command", flagged.flag_names.size(), m);
+}
+
+// What a user waits for, from building the tree to the handler running, n is
+// the total number of flags in the tree.
+void bench_main()
+{
+  auto shape = make_tree_shape(50, 20, 8);
+  size_t n = shape.group_names.size() * shape.command_names.size() *
+             shape.flag_names.size();
+  vector<const char*> argv = {
+    "bench",
+    shape.group_names.back().c_str(),
+    shape.command_names.back().c_str(),
+    shape.flag_names.back().c_str(),
+    "value",
+  };
+  auto m = measure([&]() -> ptrdiff_t {
+    auto tree = build_tree(default_resource(), shape);
+    return tree.main(argv.size(), argv.data());
+  });
+  report("main/time_to_handler", n, m);
+
+  // The same tree with static commands
+  m = measure([&]() -> ptrdiff_t {
+    GroupBuilder root("Root");
+    for (const auto& group_name : shape.group_names) {
+      GroupBuilder group("Generated group");
+      for (const auto& command_name : shape.command_names) {
+        group.cmd(command_name, static_generated_command());
+      }
+      root.cmd(group_name, group.build());
+    }
+    return root.build().main(argv.size(), argv.data());
+  });
+  report("static/time_to_handler", n, m);
+}
+
+} // namespace
+} // namespace command
+
+int main(int argc, char** argv)
+{
+  size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  command::bench_repeated_anon_storage(n);
+  command::bench_repeated_anon_numeric(n);
+  command::bench_build_tree();
+  for (auto [num_flags, num_args] : {
+         std::pair<size_t, size_t>{8, 0},
+         {8, 8},
+         {64, 8},
+         {64, 64},
+         {512, 8},
+         {512, 512},
+       }) {
+    command::bench_parse_args(num_flags, num_args);
+  }
+  command::bench_static_parse_args();
+  for (size_t depth : {1, 4, 16}) {
+    for (size_t width : {4, 64, 1024}) {
+      command::bench_dispatch(depth, width);
+    }
+  }
+  command::bench_print_help();
+  command::bench_main();
+  return 0;
+}
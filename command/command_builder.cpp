@@ -1,17 +1,25 @@
 #include "command_builder.hpp"
 
 #include <algorithm>
-#include <exception>
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string>
 #include <type_traits>
 #include <vector>
 
+#include "arena.hpp"
 #include "command_base.hpp"
 #include "command_flags.hpp"
+#include "flag_index.hpp"
+#include "parse_state.hpp"
+#include "perf_counters.hpp"
+#include "profile.hpp"
+#include "response_file.hpp"
 
-#include "bee/file_writer.hpp"
 #include "bee/or_error.hpp"
 #include "bee/print.hpp"
-#include "bee/string_util.hpp"
 
 using std::decay_t;
 using std::is_same_v;
@@ -40,75 +48,105 @@ bool is_required(const Flag& flag)
     flag);
 }
 
-const string& flag_name(const Flag& flag)
+bool is_flag_arg(const std::string_view& arg)
 {
-  return visit([&](auto flag) -> const string& { return flag->name(); }, flag);
-}
-
-bee::OrError<Flag> find_flag(const vector<Flag>& flags, const string& name)
-{
-  for (const auto& flag : flags) {
-    if (name == flag_name(flag)) { return flag; }
-  }
-  return bee::Error::fmt("Unknown flag '$'", name);
+  return arg.size() > 1 && arg.front() == '-';
 }
 
 bee::OrError<> parse_args(
-  const vector<Flag>& named_flags,
-  const vector<AnonFlag::ptr>& anon_flags,
-  const bee::ArrayView<const std::string> args)
+  const FlagIndex& flag_index,
+  const std::pmr::vector<Flag>& named_flags,
+  const std::pmr::vector<AnonFlag::ptr>& anon_flags,
+  const bee::ArrayView<const std::string_view> args)
 {
   size_t anon_flag_index = 0;
   bool flag_escaped = false;
   for (size_t i = 0; i < args.size();) {
-    const string& arg = args.at(i++);
-    if (arg.front() == '-' && !flag_escaped) {
+    const std::string_view& arg = args.at(i++);
+    if (is_flag_arg(arg) && !flag_escaped) {
       if (arg == "--") {
         flag_escaped = true;
         continue;
       }
-      bail(flag, find_flag(named_flags, arg));
+      bail(match, flag_index.find(arg));
       bail_unit(visit(
         [&](auto flag) -> bee::OrError<> {
           using T = decay_t<decltype(flag)>;
           if constexpr (is_same_v<T, ValueFlag::ptr>) {
-            if (i >= args.size()) {
+            std::string_view value;
+            if (match.value.has_value()) {
+              value = *match.value;
+            } else if (i < args.size()) {
+              value = args.at(i++);
+            } else {
               return bee::Error::fmt("No arguments for flag $", arg);
             }
-            auto value = args.at(i++);
-            auto err = flag->parse_value(value);
+            auto err = [&] {
+              Profiler::Span span("of_string", flag->name());
+              return flag->parse_value(value);
+            }();
             if (err.is_error()) {
               return bee::Error::fmt(
                 "Failed to parse flag $ with value '$': $",
-                arg,
+                flag->name(),
                 value,
                 err.error());
             }
             return bee::ok();
           } else if constexpr (is_same_v<T, BooleanFlag::ptr>) {
+            if (match.value.has_value()) {
+              return bee::Error::fmt(
+                "Flag $ does not take a value", flag->name());
+            }
             flag->set();
             return bee::ok();
           } else {
             static_assert(bee::always_false<T> && "visit is not exhaustive");
           }
         },
-        flag));
+        match.flag));
     } else {
       // Anon arg
       if (anon_flag_index >= anon_flags.size()) {
         return bee::Error::fmt("Unexpected anonymous argument '$'", arg);
       }
       auto&& flag = anon_flags[anon_flag_index];
-      auto err = flag->parse_value(arg);
+      if (flag->is_repeated()) {
+        // Hand the whole run of anonymous arguments to the flag at once so
+        // specs with batch parsers can process them together.
+        size_t run_begin = i - 1;
+        while (i < args.size() && (flag_escaped || !is_flag_arg(args[i]))) {
+          i++;
+        }
+        bee::ArrayView<const std::string_view> run(
+          args.data() + run_begin, i - run_begin);
+        size_t parsed = 0;
+        auto err = [&] {
+          Profiler::Span span("of_string", flag->value_name().value_or("anon"));
+          return flag->parse_values(run, parsed);
+        }();
+        if (err.is_error()) {
+          return bee::Error::fmt(
+            "Failed to parse anon flag with value '$': $",
+            run[parsed],
+            err.error());
+        }
+        continue;
+      }
+      auto err = [&] {
+        Profiler::Span span("of_string", flag->value_name().value_or("anon"));
+        return flag->parse_value(arg);
+      }();
       if (err.is_error()) {
         return bee::Error::fmt(
           "Failed to parse anon flag with value '$': $", arg, err.error());
       }
       // TODO: Need to validate that there are no other anon flags after a
       // repeated anon one.
-      if (!flag->is_repeated()) { anon_flag_index++; }
+      anon_flag_index++;
     }
   }
+  Profiler::Span span("finish_parsing");
   for (const auto& flag : named_flags) {
     bail_unit(visit(
       [&](auto flag) -> bee::OrError<> {
@@ -133,28 +171,53 @@ bee::OrError<> parse_args(
 // Command
 //
 
-bool by_optional(const Flag& f1, const Flag& f2)
+// Required flags first, otherwise in the order they were added. Done in two
+// passes rather than with std::stable_sort, which takes a temporary buffer
+// from the global heap.
+std::pmr::vector<Flag> sort_flags(
+  const std::pmr::vector<Flag>& flags,
+  const BooleanFlag::ptr& show_help,
+  MemoryResource* resource)
 {
-  bool req1 = is_required(f1);
-  bool req2 = is_required(f2);
-  return req1 && !req2;
+  std::pmr::vector<Flag> sorted(resource);
+  sorted.reserve(flags.size() + 1);
+  for (const auto& flag : flags) {
+    if (is_required(flag)) { sorted.push_back(flag); }
+  }
+  for (const auto& flag : flags) {
+    if (!is_required(flag)) { sorted.push_back(flag); }
+  }
+  sorted.push_back(show_help);
+  return sorted;
 }
 
 struct Command : public CommandBase {
  public:
   Command(
-    const string& description,
-    const vector<Flag>& flags,
-    const vector<AnonFlag::ptr>& anon_flags,
-    handler_type handler)
-      : CommandBase(description),
+    const std::string_view& description,
+    const std::pmr::vector<Flag>& flags,
+    const std::pmr::vector<AnonFlag::ptr>& anon_flags,
+    size_t num_slots,
+    LazyParsing lazy_parsing,
+    bool response_files,
+    const PathFlag::ptr& profile,
+    const PathFlag::ptr& perf_counters,
+    handler_type handler,
+    MemoryResource* resource)
+      : CommandBase(description, resource),
         _handler(handler),
-        _flags(flags),
-        _anon_flags(anon_flags)
+        _num_slots(num_slots + 1),
+        _lazy_parsing(lazy_parsing),
+        _response_files(response_files),
+        _profile(profile),
+        _perf_counters(perf_counters),
+        _show_help(
+          BooleanFlag::create("--help", "Displays this help", resource)),
+        _flags(sort_flags(flags, _show_help, resource)),
+        _anon_flags(anon_flags, resource),
+        _flag_index(_flags, resource)
   {
-    std::stable_sort(_flags.begin(), _flags.end(), by_optional);
-    _show_help = BooleanFlag::create("--help", "Displays this help");
-    _flags.push_back(_show_help);
+    _show_help->set_slot(num_slots);
   }
 
   Command(Command&& other) = default;
@@ -162,12 +225,30 @@ struct Command : public CommandBase {
   Command& operator=(const Command& other) = delete;
 
   static std::shared_ptr<Command> make(
-    const std::string& description,
-    const std::vector<Flag>& flags,
-    const std::vector<AnonFlag::ptr>& anon_flags,
-    handler_type handler)
+    const std::string_view& description,
+    const std::pmr::vector<Flag>& flags,
+    const std::pmr::vector<AnonFlag::ptr>& anon_flags,
+    size_t num_slots,
+    LazyParsing lazy_parsing,
+    bool response_files,
+    const PathFlag::ptr& profile,
+    const PathFlag::ptr& perf_counters,
+    handler_type handler,
+    MemoryResource* resource)
   {
-    return make_shared<Command>(description, flags, anon_flags, handler);
+    return make_shared_in<Command>(resource, [&](void* mem) {
+      return new (mem) Command(
+        description,
+        flags,
+        anon_flags,
+        num_slots,
+        lazy_parsing,
+        response_files,
+        profile,
+        perf_counters,
+        handler,
+        resource);
+    });
   }
 
   virtual ~Command() {}
@@ -176,72 +257,124 @@ struct Command : public CommandBase {
 
   virtual int execute(
     const bee::LogOutput log_output,
-    const bee::ArrayView<const std::string> args) const override
+    const bee::ArrayView<const std::string_view> args) const override
   {
-    {
-      auto err = parse_args(_flags, _anon_flags, args);
-      if (_show_help->value()) {
-        print_help(log_output);
-        return 0;
-      }
-
-      if (err.is_error()) {
-        PF(log_output, "ERROR: $\n", err.error());
-        print_help(log_output);
-        return 1;
-      }
+    if (_profile == nullptr || Profiler::current() != nullptr) {
+      std::optional<std::string> ignored;
+      return _execute(log_output, args, ignored);
     }
+    // Whether to profile is only known once the arguments are parsed, so the
+    // profiler records from the start and the trace is dropped without the flag
+    return run_profiled(log_output, [&](std::optional<std::string>& path) {
+      return _execute(log_output, args, path);
+    });
+  }
 
-    auto err = _run();
-    if (err.is_error()) {
-      PF(log_output, "Application exited with error:");
-      PF(log_output, err.error().full_msg());
-      return 1;
+  virtual void describe(CompletionTree& tree) const override
+  {
+    for (const auto& flag : _flags) {
+      visit(
+        [&]<class T>(const T& flag) {
+          CompletionTree::Flag& out =
+            tree.flags.emplace_back(string(flag->name()), std::nullopt);
+          if constexpr (is_same_v<T, ValueFlag::ptr>) {
+            out.value_name = string(flag->value_name().value_or("_"));
+          }
+        },
+        flag);
     }
-
-    return 0;
   }
 
   void print_help(const bee::LogOutput log_output) const
   {
     vector<FlagDoc> docs;
-    PF(log_output, "Accepted flags:");
     for (const auto& flag : _anon_flags) { docs.push_back(flag->make_doc()); }
     for (const auto& flag : _flags) { docs.push_back(make_doc(flag)); }
+    print_flag_docs(log_output, docs);
+  }
+
+ private:
+  int _execute(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view> args,
+    std::optional<std::string>& profile_path) const
+  {
+    // Per call scratch memory, released when the call returns.
+    std::array<std::byte, 1024> buffer;
+    std::pmr::monotonic_buffer_resource parse_arena(
+      buffer.data(), buffer.size());
+
+    // Everything parsed by this call, read by the flags while it's current.
+    ParseState state(
+      _num_slots, &parse_arena, _lazy_parsing != LazyParsing::Disabled);
+    ParseState::Scope scope(state);
+
+    // Owns the response files the arguments may point into, so it has to
+    // outlive the handler.
+    ExpandedArgs expanded(&parse_arena);
+    auto err = [&] {
+      Profiler::Span span("parse");
+      return _parse(args, expanded);
+    }();
+    if (_show_help->value()) {
+      print_help(log_output);
+      return 0;
+    }
 
-    int max_left = 0;
-    for (const auto& doc : docs) {
-      max_left = std::max<int>(max_left, doc.left.size());
+    if (!err.is_error() && _profile != nullptr) {
+      profile_path = _profile->value();
     }
 
-    for (const auto& doc : docs) {
-      string line = "    " + bee::right_pad_string(doc.left, max_left);
-      if (doc.right.has_value() && !doc.right->empty()) {
-        line += "  ";
-        line += *doc.right;
-      }
-      PF(log_output, line);
+    if (!err.is_error() && _lazy_parsing == LazyParsing::ValidateBeforeRun) {
+      err = _validate();
+    }
+
+    if (err.is_error()) {
+      record_error(err.error());
+      PF(log_output, "ERROR: $\n", err.error());
+      print_help(log_output);
+      return 1;
     }
+
+    if (_perf_counters != nullptr && _perf_counters->value().has_value()) {
+      return run_with_perf_counters(*_perf_counters->value(), log_output, [&] {
+        return run_handler(log_output, _handler);
+      });
+    }
+    return run_handler(log_output, _handler);
   }
 
- private:
-  bee::OrError<> _run() const
+  bee::OrError<> _parse(
+    const bee::ArrayView<const std::string_view>& args,
+    ExpandedArgs& expanded) const
+  {
+    if (_response_files && has_response_files(args)) {
+      bail_unit(expand_response_files(args, expanded));
+      return parse_args(_flag_index, _flags, _anon_flags, expanded.view());
+    }
+    return parse_args(_flag_index, _flags, _anon_flags, args);
+  }
+
+  bee::OrError<> _validate() const
   {
-    try {
-      return _handler();
-    } catch (const bee::Exn& err) {
-      std::ignore = bee::FileWriter::stdout().flush();
-      return bee::Error(err);
-    } catch (const std::exception& err) {
-      std::ignore = bee::FileWriter::stdout().flush();
-      throw;
+    for (const auto& flag : _flags) {
+      if (auto value_flag = std::get_if<ValueFlag::ptr>(&flag)) {
+        bail_unit((*value_flag)->validate());
+      }
     }
+    return bee::ok();
   }
 
   handler_type _handler;
-  std::vector<Flag> _flags;
-  std::vector<AnonFlag::ptr> _anon_flags;
+  size_t _num_slots;
+  LazyParsing _lazy_parsing;
+  bool _response_files;
+  PathFlag::ptr _profile;
+  PathFlag::ptr _perf_counters;
   BooleanFlag::ptr _show_help;
+  std::pmr::vector<Flag> _flags;
+  std::pmr::vector<AnonFlag::ptr> _anon_flags;
+  FlagIndex _flag_index;
 };
 
 } // namespace
@@ -250,22 +383,72 @@ struct Command : public CommandBase {
 // CommandBuilder
 //
 
-CommandBuilder::CommandBuilder(const std::string_view& description)
-    : _description(description)
-{}
+CommandBuilder::CommandBuilder(
+  const std::string_view& description, MemoryResource* resource)
+    : _resource(resource),
+      _description(description, resource),
+      _flags(resource),
+      _anon_flags(resource)
+{
+  Profiler::note_construction();
+}
 
 FlagWrapper<BooleanFlag> CommandBuilder::no_arg(
-  const std::string_view& name, const opt_str& doc)
+  const std::string_view& name, const opt_strview& doc)
+{
+  return _add_flag(BooleanFlag::create(name, doc, _resource));
+}
+
+CommandBuilder& CommandBuilder::lazy_parsing(LazyParsing mode)
+{
+  _lazy_parsing = mode;
+  return *this;
+}
+
+CommandBuilder& CommandBuilder::response_files()
+{
+  _response_files = true;
+  return *this;
+}
+
+CommandBuilder& CommandBuilder::profile(const std::string_view& name)
+{
+  _profile = PathFlag::create(
+    name,
+    flags::String,
+    "file",
+    "Writes a timed trace of this invocation to file",
+    _resource);
+  _add_flag(_profile);
+  return *this;
+}
+
+CommandBuilder& CommandBuilder::perf_counters(const std::string_view& name)
 {
-  auto flag = BooleanFlag::create(name, doc);
-  _flags.push_back(flag);
-  return wrap_flag(flag);
+  _perf_counters = PathFlag::create(
+    name,
+    flags::String,
+    "file",
+    "Measures the handler with hardware performance counters and prints a "
+    "summary for -, or writes it to file",
+    _resource);
+  _add_flag(_perf_counters);
+  return *this;
 }
 
 Cmd CommandBuilder::run(handler_type handler)
 {
-  return Cmd(
-    Command::make(_description, _flags, _anon_flags, std::move(handler)));
+  return Cmd(Command::make(
+    _description,
+    _flags,
+    _anon_flags,
+    _num_slots,
+    _lazy_parsing,
+    _response_files,
+    _profile,
+    _perf_counters,
+    std::move(handler),
+    _resource));
 }
 
 } // namespace command
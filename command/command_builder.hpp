@@ -2,10 +2,14 @@
 
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include <unistd.h>
+
+#include "arena.hpp"
 #include "cmd.hpp"
 #include "command_flags.hpp"
 
@@ -31,23 +35,60 @@ template <class T> auto wrap_flag(const std::shared_ptr<T>& flag)
   return FlagWrapper<T>(flag);
 }
 
+// Built-in flags that take a file, see CommandBuilder::profile.
+using PathFlag = FlagTemplate<flags::StringFlag>;
+
+enum class LazyParsing {
+  // Values are parsed while the arguments are read.
+  Disabled,
+  // Values of named flags are parsed the first time the handler accesses
+  // them, and parsing errors are thrown from the accessor.
+  OnAccess,
+  // Like OnAccess, but all values given are parsed after --help is handled
+  // and before the handler runs, so errors are reported like parsing errors.
+  ValidateBeforeRun,
+};
+
+template <class T> struct StructBinding;
+
 struct CommandBuilder {
  public:
-  CommandBuilder(const std::string_view& description);
+  // Flags and the command are allocated from resource, which must outlive the
+  // Cmd returned by run, see arena.hpp.
+  CommandBuilder(
+    const std::string_view& description,
+    MemoryResource* resource = default_resource());
+
+  CommandBuilder& lazy_parsing(LazyParsing mode);
+
+  // Adds a flag that writes a trace of the invocation to a file, with the time
+  // and allocations spent parsing each flag and running the handler, see
+  // profile.hpp.
+  CommandBuilder& profile(const std::string_view& name = "--profile");
+
+  // Adds a flag that measures the handler with hardware performance counters
+  // and prints a summary for -, or writes it to a file, see perf_counters.hpp.
+  CommandBuilder& perf_counters(
+    const std::string_view& name = "--perf-counters");
+
+  // Replaces @path arguments, including flag values, with the arguments read
+  // from the file, see response_file.hpp. An argument @@arg is passed on as
+  // @arg. Off by default, so arguments that start with @ are left alone.
+  CommandBuilder& response_files();
 
   FlagWrapper<BooleanFlag> no_arg(
-    const std::string_view& name, const opt_str& doc = std::nullopt);
+    const std::string_view& name, const opt_strview& doc = std::nullopt);
 
   template <class S>
   auto optional(
     const std::string_view& name,
     const S& spec,
-    const opt_str& value_name = std::nullopt,
-    const opt_str& doc = std::nullopt)
+    const opt_strview& value_name = std::nullopt,
+    const opt_strview& doc = std::nullopt)
   {
-    auto flag = FlagTemplate<S>::create(name, spec, value_name, doc);
-    _flags.push_back(flag);
-    return wrap_flag(flag);
+    auto flag =
+      FlagTemplate<S>::create(name, spec, value_name, doc, _resource);
+    return _add_flag(flag);
   }
 
   template <class S>
@@ -55,63 +96,280 @@ struct CommandBuilder {
     const std::string_view& name,
     const S& spec,
     const typename S::value_type& def,
-    const opt_str& value_name = std::nullopt,
-    const opt_str& doc = std::nullopt)
+    const opt_strview& value_name = std::nullopt,
+    const opt_strview& doc = std::nullopt)
   {
-    auto flag =
-      RequiredFlagTemplate<S>::create(name, spec, value_name, doc, def);
-    _flags.push_back(flag);
-    return wrap_flag(flag);
+    auto flag = RequiredFlagTemplate<S>::create(
+      name, spec, value_name, doc, def, _resource);
+    return _add_flag(flag);
   }
 
   template <class S>
   auto required(
     const std::string_view& name,
     const S& spec,
-    const opt_str& value_name = std::nullopt,
-    const opt_str& doc = std::nullopt)
+    const opt_strview& value_name = std::nullopt,
+    const opt_strview& doc = std::nullopt)
   {
-    auto flag = RequiredFlagTemplate<S>::create(name, spec, value_name, doc);
-    _flags.push_back(flag);
-    return wrap_flag(flag);
+    auto flag = RequiredFlagTemplate<S>::create(
+      name, spec, value_name, doc, std::nullopt, _resource);
+    return _add_flag(flag);
   }
 
   template <class S>
   auto anon(
-    const S& spec, const opt_str& value_name, const opt_str& doc = std::nullopt)
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt)
   {
-    auto flag = AnonFlagTemplate<S>::create(spec, value_name, doc);
-    _anon_flags.push_back(flag);
-    return wrap_flag(flag);
+    auto flag = AnonFlagTemplate<S>::create(spec, value_name, doc, _resource);
+    return _add_anon_flag(flag);
   }
 
   template <class S>
   auto required_anon(
-    const S& spec, const opt_str& value_name, const opt_str& doc = std::nullopt)
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt)
   {
-    auto flag = RequiredAnonFlagTemplate<S>::create(spec, value_name, doc);
-    _anon_flags.push_back(flag);
-    return wrap_flag(flag);
+    auto flag =
+      RequiredAnonFlagTemplate<S>::create(spec, value_name, doc, _resource);
+    return _add_anon_flag(flag);
   }
 
   template <class S>
   auto repeated_anon(
-    const S& spec, const opt_str& value_name, const opt_str& doc = std::nullopt)
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt)
   {
-    auto flag = RepeatedAnonFlagTemplate<S>::create(spec, value_name, doc);
-    _anon_flags.push_back(flag);
-    return wrap_flag(flag);
+    auto flag =
+      RepeatedAnonFlagTemplate<S>::create(spec, value_name, doc, _resource);
+    return _add_anon_flag(flag);
+  }
+
+  // Like repeated_anon, but the values are kept in a Column, which packs
+  // strings into a single buffer instead of one allocation per value.
+  template <class S>
+  auto repeated_anon_columnar(
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt)
+  {
+    auto flag =
+      RepeatedAnonFlagTemplate<S, Column<typename S::value_type>>::create(
+        spec, value_name, doc, _resource);
+    return _add_anon_flag(flag);
   }
 
+  // Like repeated_anon, but the values are read and parsed lazily as the
+  // handler iterates them, and an argument "-" streams items separated by
+  // delimiter from fd. Memory use doesn't depend on the number of items.
+  // Items read from fd are overwritten as the stream advances, so specs whose
+  // values point into the input, like flags::StringView, are rejected.
+  template <class S>
+  auto streamed_anon(
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt,
+    char delimiter = '\n',
+    int fd = STDIN_FILENO)
+  {
+    auto flag = StreamedAnonFlagTemplate<S>::create(
+      spec, value_name, doc, fd, delimiter, _resource);
+    return _add_anon_flag(flag);
+  }
+
+  // Binds flags to members of a T owned by the command, see StructBinding.
+  template <class T> StructBinding<T> bind();
+
   Cmd run(handler_type handler);
 
   const std::string& description() const;
 
  private:
-  std::string _description;
-  std::vector<Flag> _flags;
+  template <class T> friend struct StructBinding;
 
-  std::vector<AnonFlag::ptr> _anon_flags;
+  // Every flag gets a slot in the ParseState of each invocation.
+  template <class F> FlagWrapper<F> _add_flag(const std::shared_ptr<F>& flag)
+  {
+    flag->set_slot(_num_slots++);
+    _flags.push_back(flag);
+    return wrap_flag(flag);
+  }
+
+  template <class F>
+  FlagWrapper<F> _add_anon_flag(const std::shared_ptr<F>& flag)
+  {
+    flag->set_slot(_num_slots++);
+    _anon_flags.push_back(flag);
+    return wrap_flag(flag);
+  }
+
+  MemoryResource* _resource;
+  size_t _num_slots = 0;
+  std::pmr::string _description;
+  LazyParsing _lazy_parsing = LazyParsing::Disabled;
+  bool _response_files = false;
+  PathFlag::ptr _profile;
+  PathFlag::ptr _perf_counters;
+  std::pmr::vector<Flag> _flags;
+
+  std::pmr::vector<AnonFlag::ptr> _anon_flags;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// StructBinding
+//
+// Parses flags directly into the members of a single T, which is passed to
+// the handler, instead of keeping each value in its own flag object:
+//
+//   struct Options {
+//     std::optional<std::string> name;
+//     int count = 1;
+//     bool verbose = false;
+//     std::vector<std::string> files;
+//   };
+//
+//   auto builder = CommandBuilder("Does things");
+//   auto binding = builder.bind<Options>();
+//   binding.optional("--name", flags::String, &Options::name)
+//     .optional("--count", flags::Int, &Options::count)
+//     .no_arg("--verbose", &Options::verbose)
+//     .repeated_anon(flags::String, &Options::files, "files");
+//   return binding.run([](const Options& opts) { ... });
+//
+// Each invocation parses into its own default constructed T, so members'
+// initial values are the defaults.
+//
+
+template <class T> struct StructBinding {
+ public:
+  using handler_type = std::function<bee::OrError<>(const T&)>;
+
+  explicit StructBinding(CommandBuilder& builder)
+      : _builder(builder), _object_slot(builder._num_slots++)
+  {}
+
+  StructBinding& no_arg(
+    const std::string_view& name,
+    bool T::*member,
+    const opt_strview& doc = std::nullopt)
+  {
+    _builder._add_flag(BoundBooleanFlag<T>::create(
+      name, doc, _target(member), _builder._resource));
+    return *this;
+  }
+
+  // member is either a std::optional of the spec value type, or the value type
+  // itself, in which case its initial value is the default.
+  template <class S, class M>
+  StructBinding& optional(
+    const std::string_view& name,
+    const S& spec,
+    M T::*member,
+    const opt_strview& value_name = std::nullopt,
+    const opt_strview& doc = std::nullopt)
+  {
+    return _add(name, spec, member, value_name, doc, false);
+  }
+
+  template <class S, class M>
+  StructBinding& required(
+    const std::string_view& name,
+    const S& spec,
+    M T::*member,
+    const opt_strview& value_name = std::nullopt,
+    const opt_strview& doc = std::nullopt)
+  {
+    return _add(name, spec, member, value_name, doc, true);
+  }
+
+  template <class S>
+  StructBinding& anon(
+    const S& spec,
+    std::optional<typename S::value_type> T::*member,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt)
+  {
+    return _add_anon(spec, member, value_name, doc);
+  }
+
+  template <class S>
+  StructBinding& required_anon(
+    const S& spec,
+    typename S::value_type T::*member,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt)
+  {
+    return _add_anon(spec, member, value_name, doc);
+  }
+
+  template <class S>
+  StructBinding& repeated_anon(
+    const S& spec,
+    std::vector<typename S::value_type> T::*member,
+    const opt_strview& value_name,
+    const opt_strview& doc = std::nullopt)
+  {
+    return _add_anon(spec, member, value_name, doc);
+  }
+
+  Cmd run(handler_type handler)
+  {
+    return _builder.run([slot = _object_slot,
+                         handler = std::move(handler)]() -> bee::OrError<> {
+      return handler(ParseState::current().get<T>(slot));
+    });
+  }
+
+ private:
+  template <class M> BoundTarget<T, M> _target(M T::*member) const
+  {
+    return {.member = member, .object_slot = _object_slot};
+  }
+
+  template <class S, class M>
+  StructBinding& _add(
+    const std::string_view& name,
+    const S& spec,
+    M T::*member,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    bool required)
+  {
+    _builder._add_flag(BoundFlagTemplate<S, T, M>::create(
+      name,
+      spec,
+      value_name,
+      doc,
+      _target(member),
+      _defaults.*member,
+      required,
+      _builder._resource));
+    return *this;
+  }
+
+  template <class S, class M>
+  StructBinding& _add_anon(
+    const S& spec,
+    M T::*member,
+    const opt_strview& value_name,
+    const opt_strview& doc)
+  {
+    _builder._add_anon_flag(BoundAnonFlagTemplate<S, T, M>::create(
+      spec, value_name, doc, _target(member), _builder._resource));
+    return *this;
+  }
+
+  CommandBuilder& _builder;
+  const size_t _object_slot;
+  const T _defaults{};
+};
+
+template <class T> StructBinding<T> CommandBuilder::bind()
+{
+  return StructBinding<T>(*this);
+}
+
 } // namespace command
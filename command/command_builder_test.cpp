@@ -1,4 +1,9 @@
+#include <filesystem>
+#include <fstream>
 #include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
 
 #include "command_builder.hpp"
 
@@ -172,6 +177,438 @@ TEST(repeated_anon)
   run_test({"--", "cmd", "--flag", "--other-flag"});
 }
 
+TEST(string_view)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    auto name = builder.optional_with_default("--name", StringView, "none");
+    auto files = builder.repeated_anon(StringView, "files");
+    run_command(std::move(args), builder.run([=]() {
+      P("name:$ files:$", *name, *files);
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({});
+  run_test({"--help"});
+  run_test({"--name", "foo", "a.txt", "b.txt"});
+}
+
+TEST(repeated_anon_columnar)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    auto ints = builder.optional("--ints", Int);
+    auto strs = builder.repeated_anon_columnar(String, "strs");
+    run_command(std::move(args), builder.run([=]() {
+      P("ints:$ size:$", *ints, strs->size());
+      for (std::string_view str : *strs) { P("str:'$'", str); }
+      if (!strs->empty()) { P("last:'$'", (*strs)[strs->size() - 1]); }
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({});
+  run_test({"--help"});
+  run_test({"foo", "", "a longer string that does not fit in sso"});
+}
+
+TEST(repeated_numeric)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    auto flag = builder.optional("--flag", String);
+    auto ints = builder.repeated_anon(Int, "ints");
+    run_command(std::move(args), builder.run([=]() {
+      P("flag:$ ints:$", *flag, *ints);
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({"1", "12345678", "123456789", "2147483647"});
+  run_test({"--", "-2", "-99999999", "-2147483648", "-0"});
+  run_test({"1", "--flag", "x", "007", "2"});
+  run_test({"1", "2", "3a", "4"});
+  run_test({"1", "", "4"});
+  run_test({"1", "-", "4"});
+  run_test({"1", "99999999999"});
+
+  auto float_builder = CommandBuilder("Sub command");
+  auto floats = float_builder.repeated_anon(Float, "floats");
+  run_command({"1.5", "1e3", "--", "-2", "0.125"}, float_builder.run([=]() {
+    P("floats:$", *floats);
+    return bee::ok();
+  }));
+}
+
+TEST(numeric_specs)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    auto i32 = builder.optional("--i32", Int32);
+    auto i64 = builder.optional("--i64", Int64);
+    auto u64 = builder.optional("--u64", UInt64);
+    auto size = builder.optional("--size", Size);
+    auto f32 = builder.optional_with_default("--f32", Float32, 0.1f);
+    auto f64 = builder.optional_with_default("--f64", Float, 0.1);
+    run_command(std::move(args), builder.run([=]() {
+      P("i32:$ i64:$ u64:$ size:$", *i32, *i64, *u64, *size);
+      P("f32:$ f64:$", Float32.to_string(*f32), Float.to_string(*f64));
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({"--help"});
+  run_test(
+    {"--i32",
+     "-2147483648",
+     "--i64",
+     "-9223372036854775808",
+     "--u64",
+     "18446744073709551615",
+     "--size",
+     "0",
+     "--f32",
+     "1.5",
+     "--f64",
+     "1e300"});
+  run_test({"--i32", "2147483648"});
+  run_test({"--u64", "-1"});
+  run_test({"--i64", "12x"});
+  run_test({"--f32", "1e39"});
+  run_test({"--f64", "1e-400"});
+  run_test({"--i32", "+7", "--u64", "+8", "--f64", "+0.5"});
+  run_test({"--i32", "+-7"});
+  run_test({"--i32", " 7"});
+  run_test({"--f64", "0.1234567891"});
+  P("default: $", Float.to_string(0.1234567891));
+}
+
+TEST(list_flags)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    auto shards = builder.required("--shards", List(Int));
+    auto names = builder.optional_with_default(
+      "--names", List(String, ':'), vector<string>{"a", "b"});
+    run_command(std::move(args), builder.run([=]() {
+      P("shards:$ size:$ names:$", *shards, shards->size(), *names);
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({"--help"});
+  run_test({"--shards", "1,5,9"});
+  run_test({"--shards=", "--names", "x::y"});
+  run_test({"--shards", "1,,3"});
+  run_test({"--shards", "1,2a"});
+}
+
+TEST(response_files)
+{
+  auto write_file = [&](const string& name, const string& content) {
+    std::ofstream(name, std::ios::binary) << content;
+    return name;
+  };
+  auto lines = write_file(
+    "command_response_lines", "--name\r\nfoo\n\nb.txt\n\"\"\n\"x\\\"y\nz\"\n");
+  auto nul = write_file("command_response_nul", string("c.txt\0d e\0", 10));
+  auto bad = write_file("command_response_bad", "\"unterminated\n");
+  auto empty = write_file("command_response_empty", "");
+
+  int test_count = 1;
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    auto builder = CommandBuilder("Sub command");
+    builder.response_files();
+    auto name = builder.optional("--name", StringView);
+    auto files = builder.repeated_anon(StringView, "files");
+    run_command(std::move(args), builder.run([=]() {
+      P("name:$", *name);
+      for (const auto& file : *files) { P("file:'$'", file); }
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({"a.txt", "@" + lines});
+  run_test({"--name", "@@alice", "@@" + lines, "@"});
+  run_test({"@" + nul, "--", "@" + nul});
+  run_test({"@" + bad});
+  run_test({"@/nonexistent/command_response"});
+  run_test({"@" + empty, "e.txt"});
+
+  // Pipes can't be mapped, they are read instead
+  int fds[2];
+  if (pipe(fds) != 0) { throw std::runtime_error("pipe failed"); }
+  const string piped = "--name\npiped\nf.txt\n";
+  if (write(fds[1], piped.data(), piped.size()) != ssize_t(piped.size())) {
+    throw std::runtime_error("write failed");
+  }
+  close(fds[1]);
+  run_test({"@/dev/fd/" + std::to_string(fds[0])});
+  close(fds[0]);
+
+  run_test({"@."});
+
+  for (const auto& file : {lines, nul, bad, empty}) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST(response_files_disabled)
+{
+  auto builder = CommandBuilder("Sub command");
+  auto user = builder.optional("--user", StringView);
+  auto files = builder.repeated_anon(StringView, "files");
+  run_command({"--user", "@alice", "@a.txt", "@@b.txt"}, builder.run([=]() {
+    P("user:$", *user);
+    for (const auto& file : *files) { P("file:'$'", file); }
+    return bee::ok();
+  }));
+}
+
+TEST(streamed_anon)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args, const string& input, char delim) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    int fds[2];
+    if (
+      pipe(fds) != 0 ||
+      write(fds[1], input.data(), input.size()) != ssize_t(input.size())) {
+      P("Failed to set up input pipe");
+      return;
+    }
+    close(fds[1]);
+
+    auto builder = CommandBuilder("Sub command");
+    auto values =
+      builder.streamed_anon(Int, "values", std::nullopt, delim, fds[0]);
+    run_command(std::move(args), builder.run([=]() -> bee::OrError<> {
+      int sum = 0;
+      // Only the first call reads an item
+      values->begin();
+      for (const auto& value : *values) {
+        bail(v, value);
+        P("value:$", v);
+        sum += v;
+      }
+      P("sum:$", sum);
+      return bee::ok();
+    }));
+    close(fds[0]);
+    P("------------------------------------");
+  };
+
+  run_test({"1", "2"}, "", '\n');
+  run_test({"1", "-", "5"}, "10\n20\n30", '\n');
+  run_test({"-"}, string("7\08\0", 4), '\0');
+  run_test({"-"}, "1\nx\n3\n", '\n');
+}
+
+TEST(flag_lookup)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    auto verbose = builder.no_arg("--verbose");
+    auto vflag = builder.optional("--value", flags::Int);
+    auto name = builder.optional("--name", flags::String);
+    run_command(std::move(args), builder.run([=]() {
+      P("verbose:$ value:$ name:$", *verbose, *vflag, *name);
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({"--value=12", "--name=foo=bar"});
+  run_test({"--name="});
+  run_test({"--verb", "--val", "7", "--n", "x"});
+  run_test({"--v", "7"});
+  run_test({"--verbose=yes"});
+  run_test({"--value=abc"});
+  run_test({"--nam=abc"});
+  run_test({"--other=abc"});
+}
+
+TEST(lazy_parsing)
+{
+  int test_count = 1;
+
+  auto run_test = [&](LazyParsing mode, bool use_value, vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    builder.lazy_parsing(mode);
+    auto value = builder.optional("--value", flags::Int);
+    auto other = builder.optional_with_default("--other", flags::Int, 5);
+    run_command(std::move(args), builder.run([=]() {
+      P("other:$", *other);
+      if (use_value) { P("value:$", *value); }
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test(LazyParsing::OnAccess, true, {"--value=12"});
+  run_test(LazyParsing::OnAccess, true, {});
+  run_test(LazyParsing::OnAccess, false, {"--value=abc"});
+  run_test(LazyParsing::OnAccess, true, {"--value=abc"});
+  run_test(LazyParsing::OnAccess, true, {"--value=abc", "--help"});
+  run_test(LazyParsing::ValidateBeforeRun, false, {"--value=abc"});
+  run_test(LazyParsing::ValidateBeforeRun, true, {"--value=12", "--other=3"});
+}
+
+TEST(lazy_parsing_per_command)
+{
+  // Commands built from the same flags keep their own mode
+  auto builder = CommandBuilder("Sub command");
+  builder.optional("--value", flags::Int);
+  auto handler = []() {
+    P("ran");
+    return bee::ok();
+  };
+  auto eager = builder.run(handler);
+  builder.lazy_parsing(LazyParsing::OnAccess);
+  auto lazy = builder.run(handler);
+  run_command({"--value=abc"}, eager);
+  run_command({"--value=abc"}, lazy);
+}
+
+struct BoundOptions {
+  optional<string> name;
+  int count = 1;
+  double ratio = 0;
+  bool verbose = false;
+  string mode;
+  vector<int> values;
+};
+
+TEST(struct_binding)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto builder = CommandBuilder("Sub command");
+    auto binding = builder.bind<BoundOptions>();
+    binding.optional("--name", flags::String, &BoundOptions::name)
+      .optional("--count", flags::Int, &BoundOptions::count)
+      .required("--ratio", flags::Float, &BoundOptions::ratio)
+      .no_arg("--verbose", &BoundOptions::verbose)
+      .required_anon(flags::String, &BoundOptions::mode, "mode")
+      .repeated_anon(flags::Int, &BoundOptions::values, "values");
+    run_command(std::move(args), binding.run([](const BoundOptions& opts) {
+      P("name:$ count:$ ratio:$ verbose:$ mode:$ values:$",
+        opts.name,
+        opts.count,
+        opts.ratio,
+        opts.verbose,
+        opts.mode,
+        opts.values);
+      return bee::ok();
+    }));
+    P("------------------------------------");
+  };
+
+  run_test({"--ratio", "0.5", "fast"});
+  run_test({"--name=foo", "--count", "3", "--ratio=2", "--verbose", "slow",
+            "1", "2", "3"});
+  run_test({"fast"});
+  run_test({"--ratio=1"});
+  run_test({"--ratio=1", "--count=x", "fast"});
+  run_test({"--help"});
+}
+
+TEST(reentrant)
+{
+  auto builder = CommandBuilder("Sub command");
+  auto id = builder.required("--id", flags::Int);
+  auto verbose = builder.no_arg("--verbose");
+  auto name = builder.anon(flags::String, "name");
+  auto values = builder.repeated_anon(flags::Int, "values");
+  vector<int> sums(64, -1);
+  auto cmd = builder.run([&]() {
+    int sum = *verbose ? 1000 : 0;
+    for (int v : *values) { sum += v; }
+    if (*name != F("name-$", *id)) { sum = -2; }
+    sums[*id] = sum;
+    return bee::ok();
+  });
+
+  auto make_args = [](int i) {
+    vector<string> args = {"--id", F(i), F("name-$", i)};
+    if (i % 2 == 1) { args.push_back("--verbose"); }
+    for (int v = 0; v <= i; v++) { args.push_back(F(v)); }
+    return args;
+  };
+  auto run = [&](int i) {
+    auto args = make_args(i);
+    return cmd.execute(
+      bee::LogOutput::StdOut, bee::ArrayView<const string>(args));
+  };
+
+  // Sequential runs don't see each other's values
+  P(run(3));
+  P(run(2));
+  P(sums[3]);
+  P(sums[2]);
+
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t]() {
+      for (int round = 0; round < 50; round++) {
+        for (int i = t; i < 64; i += 4) { run(i); }
+      }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+
+  int wrong = 0;
+  for (int i = 0; i < 64; i++) {
+    int expected = i * (i + 1) / 2 + (i % 2 == 1 ? 1000 : 0);
+    if (sums[i] != expected) { wrong++; }
+  }
+  P("wrong sums: $", wrong);
+
+  P(bee::try_with([&]() -> bee::OrError<> {
+    P(*id);
+    return bee::ok();
+  }));
+}
+
 TEST(exception)
 {
   auto builder = CommandBuilder("Sub command");
@@ -0,0 +1,30 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "daemon.hpp"
+
+#include "bee/log_output.hpp"
+#include "bee/print.hpp"
+
+// Forwards its arguments and stdio to a server started with the serve command
+// and exits with the exit code of the command, so a warm server can stand in
+// for the tool it serves:
+//
+//   command_client /tmp/app.sock greet --name world
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    PF(bee::LogOutput::StdErr, "Usage: $ <socket> [args...]", argv[0]);
+    return 2;
+  }
+
+  std::vector<std::string_view> args(argv + 2, argv + argc);
+  auto exit_code = command::call_server(
+    argv[1], bee::ArrayView<const std::string_view>(args));
+  if (exit_code.is_error()) {
+    PF(bee::LogOutput::StdErr, "$", exit_code.error());
+    return 2;
+  }
+  return *exit_code;
+}
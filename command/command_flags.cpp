@@ -1,73 +1,182 @@
 #include "command_flags.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
-#include "bee/parse_string.hpp"
+#include "bee/print.hpp"
+#include "bee/string_util.hpp"
 
 namespace command {
 
+opt_pmr_str to_opt_pmr_str(const opt_strview& str, MemoryResource* resource)
+{
+  if (!str.has_value()) { return std::nullopt; }
+  return std::pmr::string(*str, resource);
+}
+
+opt_strview to_opt_strview(const opt_pmr_str& str)
+{
+  if (!str.has_value()) { return std::nullopt; }
+  return *str;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
-// AnonFlag
+// FlagDoc
 //
 
-FlagDoc AnonFlag::make_doc() const
+FlagDoc make_anon_flag_doc(
+  const opt_strview& value_name,
+  const opt_strview& doc,
+  bool required,
+  bool repeated)
 {
-  auto value_name = [&]() {
-    auto value_name =
-      _value_name.has_value() ? F("<$>", *_value_name) : "<VALUE>";
-    if (!_required && !_repeated) {
-      return F("[$]", value_name);
-    } else if (_repeated) {
-      return F("[$ ...]", value_name);
-    } else {
-      return value_name;
-    }
+  auto value_name_str =
+    value_name.has_value() ? F("<$>", *value_name) : "<VALUE>";
+  if (!required && !repeated) {
+    value_name_str = F("[$]", value_name_str);
+  } else if (repeated) {
+    value_name_str = F("[$ ...]", value_name_str);
+  }
+  return {
+    .left = value_name_str,
+    .right = doc.has_value() ? opt_str(*doc) : std::nullopt,
   };
+}
+
+FlagDoc make_boolean_flag_doc(
+  const std::string_view& name, const opt_strview& doc)
+{
   return {
-    .left = value_name(),
-    .right = _doc,
+    .left = F("[$]", name),
+    .right = doc.has_value() ? opt_str(*doc) : std::nullopt,
   };
 }
 
-const opt_str& AnonFlag::value_name() const { return _value_name; }
+FlagDoc make_value_flag_doc(
+  const std::string_view& name,
+  const opt_strview& value_name,
+  const opt_strview& doc,
+  bool required,
+  const opt_str& default_str)
+{
+  auto value_name_str = value_name.has_value() ? F("<$>", *value_name) : "_";
+  auto name_and_value = F("$ $", name, value_name_str);
+  if (!required) { name_and_value = F("[$]", name_and_value); }
+
+  std::string doc_str;
+  if (doc.has_value()) { doc_str = *doc; }
+  if (default_str.has_value()) {
+    if (!doc_str.empty()) { doc_str += ' '; };
+    doc_str += F("[default = $]", *default_str);
+  }
+  return {
+    .left = name_and_value,
+    .right = doc_str,
+  };
+}
+
+void print_flag_docs(
+  const bee::LogOutput log_output, const std::vector<FlagDoc>& docs)
+{
+  PF(log_output, "Accepted flags:");
+
+  size_t max_left = 0;
+  for (const auto& doc : docs) {
+    max_left = std::max(max_left, doc.left.size());
+  }
+
+  for (const auto& doc : docs) {
+    std::string line = "    " + bee::right_pad_string(doc.left, max_left);
+    if (doc.right.has_value() && !doc.right->empty()) {
+      line += "  ";
+      line += *doc.right;
+    }
+    PF(log_output, line);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AnonFlag
+//
+
+FlagDoc AnonFlag::make_doc() const
+{
+  return make_anon_flag_doc(
+    value_name(), to_opt_strview(_doc), _required, _repeated);
+}
+
+bee::OrError<> AnonFlag::parse_values(
+  const bee::ArrayView<const std::string_view>& values, size_t& parsed)
+{
+  for (parsed = 0; parsed < values.size(); parsed++) {
+    bail_unit(parse_value(values[parsed]));
+  }
+  return bee::ok();
+}
+
+opt_strview AnonFlag::value_name() const { return to_opt_strview(_value_name); }
+
+bee::OrError<> AnonFlag::check_provided(bool provided) const
+{
+  if (_required && !provided) {
+    if (auto vn = value_name()) {
+      return bee::Error::fmt(
+        "Anon flag <$> is required, but not provided", *vn);
+    } else {
+      return bee::Error::fmt("Anon flag is required, but not provided");
+    }
+  }
+  return bee::ok();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // NamedFlag
 //
 
-NamedFlag::NamedFlag(const std::string_view& name, const opt_strview& doc)
-    : _name(name), _doc(doc)
+NamedFlag::NamedFlag(
+  const std::string_view& name,
+  const opt_strview& doc,
+  MemoryResource* resource)
+    : _name(name, resource), _doc(to_opt_pmr_str(doc, resource))
 {}
 NamedFlag::~NamedFlag() {}
 
-const std::string& NamedFlag::name() const { return _name; }
-const opt_str& NamedFlag::doc() const { return _doc; }
+std::string_view NamedFlag::name() const { return _name; }
+opt_strview NamedFlag::doc() const { return to_opt_strview(_doc); }
 
 ////////////////////////////////////////////////////////////////////////////////
 // BooleanFlag
 //
 
-BooleanFlag::BooleanFlag(const std::string_view& name, const opt_strview& doc)
-    : NamedFlag(name, doc), _value(false)
+BooleanFlag::BooleanFlag(
+  const std::string_view& name,
+  const opt_strview& doc,
+  MemoryResource* resource)
+    : NamedFlag(name, doc, resource)
 {}
 
 BooleanFlag::~BooleanFlag() {}
 
-void BooleanFlag::set() { _value = true; }
-const bool& BooleanFlag::value() const { return _value; }
+void BooleanFlag::set() const { state<bool>() = true; }
+
+const bool& BooleanFlag::value() const { return state<bool>(); }
 
 BooleanFlag::ptr BooleanFlag::create(
-  const std::string_view& name, const opt_strview& doc)
+  const std::string_view& name,
+  const opt_strview& doc,
+  MemoryResource* resource)
 {
-  return ptr(new BooleanFlag(name, doc));
+  return make_shared_in<BooleanFlag>(resource, [&](void* mem) {
+    return new (mem) BooleanFlag(name, doc, resource);
+  });
 }
 
 FlagDoc BooleanFlag::make_doc() const
 {
-  return {
-    .left = F("[$]", name()),
-    .right = doc(),
-  };
+  return make_boolean_flag_doc(name(), doc());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -78,28 +187,24 @@ ValueFlag::ValueFlag(
   const std::string_view& name,
   const opt_strview& value_name,
   const opt_strview& doc,
-  bool required)
-    : NamedFlag(name, doc), _value_name(value_name), _required(required)
+  bool required,
+  MemoryResource* resource)
+    : NamedFlag(name, doc, resource),
+      _value_name(to_opt_pmr_str(value_name, resource)),
+      _required(required)
 {}
 
 ValueFlag::~ValueFlag() {}
 
-FlagDoc ValueFlag::make_doc() const
+opt_strview ValueFlag::value_name() const
 {
-  auto value_name = _value_name.has_value() ? F("<$>", *_value_name) : "_";
-  auto name_and_value = F("$ $", name(), value_name);
-  if (!is_required()) { name_and_value = F("[$]", name_and_value); }
+  return to_opt_strview(_value_name);
+}
 
-  std::string doc_str;
-  if (const auto& d = doc()) { doc_str = *d; }
-  if (auto def_value = default_str()) {
-    if (!doc_str.empty()) { doc_str += ' '; };
-    doc_str += F("[default = $]", *def_value);
-  }
-  return {
-    .left = name_and_value,
-    .right = doc_str,
-  };
+FlagDoc ValueFlag::make_doc() const
+{
+  return make_value_flag_doc(
+    name(), to_opt_strview(_value_name), doc(), is_required(), default_str());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -107,6 +212,43 @@ FlagDoc ValueFlag::make_doc() const
 //
 
 namespace flags {
+namespace {
+
+// Parses up to 8 decimal digits at once using SWAR (SIMD within a register):
+// the digits are loaded right aligned into a 64 bit word padded with '0',
+// validated with two masks and combined pairwise with three multiplications.
+// Returns false if the input is not 1 to 8 digits, in which case the caller
+// falls back to the scalar parser.
+bool parse_eight_digits(const std::string_view& digits, uint64_t& out)
+{
+  if constexpr (std::endian::native != std::endian::little) {
+    return false;
+  } else {
+    if (digits.empty() || digits.size() > 8) { return false; }
+    char buf[8];
+    std::memset(buf, '0', 8);
+    std::memcpy(buf + 8 - digits.size(), digits.data(), digits.size());
+    uint64_t v;
+    std::memcpy(&v, buf, 8);
+
+    constexpr uint64_t zeros = 0x3030303030303030;
+    if (
+      (v & 0xF0F0F0F0F0F0F0F0) != zeros ||
+      ((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) != zeros) {
+      return false;
+    }
+
+    v -= zeros;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+         (((v >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >>
+        32;
+    out = v;
+    return true;
+  }
+}
+
+} // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
 // StringFlag
@@ -123,33 +265,70 @@ std::string StringFlag::to_string(const std::string_view& value) const
   return std::string(value);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// StringViewFlag
+//
+
+bee::OrError<std::string_view> StringViewFlag::of_string(
+  const std::string_view& value) const
+{
+  return value;
+}
+
+std::string StringViewFlag::to_string(const std::string_view& value) const
+{
+  return std::string(value);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // IntFlag
 //
 
 bee::OrError<int> IntFlag::of_string(const std::string_view& value) const
 {
-  try {
-    return bee::parse_string<int>(value);
-  } catch (const std::invalid_argument&) {
-    return bee::Error("Not a numerical value");
-  } catch (const std::out_of_range&) {
-    return bee::Error("Numerical overflow");
+  return NumericFlag<int>().of_string(value);
+}
+
+bee::OrError<> IntFlag::of_string_many(
+  const bee::ArrayView<const std::string_view>& values,
+  std::vector<int>& out) const
+{
+  out.reserve(out.size() + values.size());
+  for (const auto& value : values) {
+    bool negative = !value.empty() && value.front() == '-';
+    uint64_t magnitude;
+    if (parse_eight_digits(value.substr(negative), magnitude)) {
+      out.push_back(negative ? -int(magnitude) : int(magnitude));
+    } else {
+      bail(parsed, of_string(value));
+      out.push_back(parsed);
+    }
   }
+  return bee::ok();
 }
 
 std::string IntFlag::to_string(int value) const { return F(value); }
 
 ////////////////////////////////////////////////////////////////////////////////
-// FlagFlag
+// FloatFlag
 //
 
 bee::OrError<double> FloatFlag::of_string(const std::string_view& value) const
 {
-  return bee::parse_string<double>(value);
+  return NumericFlag<double>().of_string(value);
+}
+
+bee::OrError<> FloatFlag::of_string_many(
+  const bee::ArrayView<const std::string_view>& values,
+  std::vector<double>& out) const
+{
+  return NumericFlag<double>().of_string_many(values, out);
 }
 
-std::string FloatFlag::to_string(float value) const { return F(value); }
+std::string FloatFlag::to_string(double value) const
+{
+  return NumericFlag<double>().to_string(value);
+}
 
 } // namespace flags
 
@@ -1,16 +1,37 @@
 #pragma once
 
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
 #include <vector>
 
+#include "arena.hpp"
+#include "column.hpp"
+#include "command_base.hpp"
+#include "delimited_reader.hpp"
 #include "flag_spec.hpp"
+#include "parse_state.hpp"
+#include "profile.hpp"
 
+#include "bee/array_view.hpp"
+#include "bee/log_output.hpp"
 #include "bee/or_error.hpp"
 
 namespace command {
 
 using opt_str = std::optional<std::string>;
 using opt_strview = std::optional<std::string_view>;
+using opt_pmr_str = std::optional<std::pmr::string>;
+
+opt_pmr_str to_opt_pmr_str(const opt_strview& str, MemoryResource* resource);
+opt_strview to_opt_strview(const opt_pmr_str& str);
 
 struct FlagDoc {
  public:
@@ -18,7 +39,28 @@ struct FlagDoc {
   std::optional<std::string> right;
 };
 
-struct AnonFlag {
+FlagDoc make_anon_flag_doc(
+  const opt_strview& value_name,
+  const opt_strview& doc,
+  bool required,
+  bool repeated);
+
+FlagDoc make_boolean_flag_doc(
+  const std::string_view& name, const opt_strview& doc);
+
+FlagDoc make_value_flag_doc(
+  const std::string_view& name,
+  const opt_strview& value_name,
+  const opt_strview& doc,
+  bool required,
+  const opt_str& default_str);
+
+void print_flag_docs(
+  bee::LogOutput log_output, const std::vector<FlagDoc>& docs);
+
+// Flag definitions are immutable once the command is built, the values they
+// parse are kept in the ParseState of each invocation, see parse_state.hpp.
+struct AnonFlag : public Stateful {
  public:
   using ptr = std::shared_ptr<AnonFlag>;
 
@@ -26,9 +68,10 @@ struct AnonFlag {
     const opt_strview& value_name,
     const opt_strview& doc,
     bool required,
-    bool repeated)
-      : _value_name(value_name),
-        _doc(doc),
+    bool repeated,
+    MemoryResource* resource = default_resource())
+      : _value_name(to_opt_pmr_str(value_name, resource)),
+        _doc(to_opt_pmr_str(doc, resource)),
         _required(required),
         _repeated(repeated)
   {}
@@ -37,6 +80,12 @@ struct AnonFlag {
 
   virtual bee::OrError<> parse_value(const std::string_view& value) = 0;
 
+  // Parses a run of consecutive values for a repeated flag. parsed is set to
+  // the number of values consumed, so on error values[parsed] is the value
+  // that failed.
+  virtual bee::OrError<> parse_values(
+    const bee::ArrayView<const std::string_view>& values, size_t& parsed);
+
   virtual bee::OrError<> finish_parsing() const = 0;
 
   FlagDoc make_doc() const;
@@ -45,16 +94,21 @@ struct AnonFlag {
 
   bool is_repeated() const { return _repeated; }
 
-  const opt_str& value_name() const;
+  opt_strview value_name() const;
+
+ protected:
+  // Fails if the flag is required and provided is false.
+  bee::OrError<> check_provided(bool provided) const;
 
  private:
-  const std::optional<std::string> _value_name;
-  const std::optional<std::string> _doc;
+  const opt_pmr_str _value_name;
+  const opt_pmr_str _doc;
   const bool _required;
   const bool _repeated;
 };
 
-template <class S, class F> struct AnonFlagBase : public AnonFlag {
+template <class S, class F, class Storage = std::vector<typename S::value_type>>
+struct AnonFlagBase : public AnonFlag {
  public:
   using ptr = std::shared_ptr<F>;
   using value_type = typename S::value_type;
@@ -62,32 +116,56 @@ template <class S, class F> struct AnonFlagBase : public AnonFlag {
   virtual ~AnonFlagBase() {}
 
   static ptr create(
-    const S& spec, const opt_strview& value_name, const opt_strview& doc)
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    MemoryResource* resource = default_resource())
   {
-    return std::make_shared<F>(spec, value_name, doc);
+    using flag_type = F;
+    return make_shared_in<flag_type>(resource, [&](void* mem) {
+      return new (mem) flag_type(spec, value_name, doc, resource);
+    });
   }
 
   virtual bee::OrError<> parse_value(const std::string_view& value) override
   {
-    if (!is_repeated() && !_value.empty()) {
-      return bee::Error("Flag already set");
+    auto& st = _state();
+    if (!is_repeated()) {
+      if (st.single.has_value()) { return bee::Error("Flag already set"); }
+      bail(parsed_value, _spec.of_string(value));
+      st.single.emplace(std::move(parsed_value));
+    } else if constexpr (
+      IdentityFlagSpec<S> &&
+      requires(Storage& storage) { storage.push_back(value); }) {
+      st.values.push_back(value);
+    } else {
+      bail(parsed_value, _spec.of_string(value));
+      st.values.push_back(std::move(parsed_value));
     }
-    bail(parsed_value, _spec.of_string(value));
-    _value.push_back(std::move(parsed_value));
     return bee::ok();
   }
 
-  virtual bee::OrError<> finish_parsing() const override
+  virtual bee::OrError<> parse_values(
+    const bee::ArrayView<const std::string_view>& values,
+    size_t& parsed) override
   {
-    if (is_required() && _value.empty()) {
-      if (auto vn = value_name()) {
-        return bee::Error::fmt(
-          "Anon flag <$> is required, but not provided", *vn);
-      } else {
-        return bee::Error::fmt("Anon flag is required, but not provided");
-      }
+    if constexpr (
+      HasOfStringMany<S> && std::is_same_v<Storage, std::vector<value_type>>) {
+      auto& st = _state();
+      size_t before = st.values.size();
+      auto err = _spec.of_string_many(values, st.values);
+      parsed = st.values.size() - before;
+      return err;
+    } else {
+      return AnonFlag::parse_values(values, parsed);
     }
-    return bee::ok();
+  }
+
+  virtual bee::OrError<> finish_parsing() const override
+  {
+    const auto& st = _state();
+    return check_provided(
+      is_repeated() ? !st.values.empty() : st.single.has_value());
   }
 
  protected:
@@ -96,14 +174,24 @@ template <class S, class F> struct AnonFlagBase : public AnonFlag {
     const opt_strview& value_name,
     const opt_strview& doc,
     bool required,
-    bool repeated)
-      : AnonFlag(value_name, doc, required, repeated), _spec(spec)
+    bool repeated,
+    MemoryResource* resource)
+      : AnonFlag(value_name, doc, required, repeated, resource), _spec(spec)
   {}
 
-  const std::vector<value_type>& value() const { return _value; }
+  const Storage& values() const { return _state().values; }
+
+  const std::optional<value_type>& single() const { return _state().single; }
 
  private:
-  std::vector<value_type> _value;
+  // Repeated flags use values, the others single.
+  struct State {
+    Storage values;
+    std::optional<value_type> single;
+  };
+
+  State& _state() const { return state<State>(); }
+
   const S _spec;
 };
 
@@ -113,22 +201,15 @@ struct AnonFlagTemplate : public AnonFlagBase<S, AnonFlagTemplate<S>> {
   using parent = AnonFlagBase<S, AnonFlagTemplate<S>>;
   using value_type = typename S::value_type;
 
-  const std::optional<value_type>& value() const
-  {
-    if (!_value_opt.has_value()) {
-      const auto& value = parent::value();
-      if (!value.empty()) { _value_opt = value[0]; }
-    }
-    return _value_opt;
-  }
+  const std::optional<value_type>& value() const { return parent::single(); }
 
   explicit AnonFlagTemplate(
-    const S& spec, const opt_strview& value_name, const opt_strview& doc)
-      : parent(spec, value_name, doc, false, false)
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    MemoryResource* resource = default_resource())
+      : parent(spec, value_name, doc, false, false, resource)
   {}
-
- private:
-  mutable std::optional<value_type> _value_opt;
 };
 
 template <class S>
@@ -137,66 +218,242 @@ struct RequiredAnonFlagTemplate
  public:
   using parent = AnonFlagBase<S, RequiredAnonFlagTemplate<S>>;
 
-  const typename S::value_type& value() const { return parent::value()[0]; }
+  const typename S::value_type& value() const { return *parent::single(); }
 
   explicit RequiredAnonFlagTemplate(
-    const S& spec, const opt_strview& value_name, const opt_strview& doc)
-      : parent(spec, value_name, doc, true, false)
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    MemoryResource* resource = default_resource())
+      : parent(spec, value_name, doc, true, false, resource)
   {}
 };
 
-template <class S>
+// Storage is the container the values are kept in, either a std::vector or a
+// Column.
+template <class S, class Storage = std::vector<typename S::value_type>>
 struct RepeatedAnonFlagTemplate
-    : public AnonFlagBase<S, RepeatedAnonFlagTemplate<S>> {
+    : public AnonFlagBase<S, RepeatedAnonFlagTemplate<S, Storage>, Storage> {
+ public:
+  using parent =
+    AnonFlagBase<S, RepeatedAnonFlagTemplate<S, Storage>, Storage>;
+
+  const Storage& value() const { return parent::values(); }
+
+  explicit RepeatedAnonFlagTemplate(
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    MemoryResource* resource = default_resource())
+      : parent(spec, value_name, doc, false, true, resource)
+  {}
+};
+
+// Lazy input range over the values of a streamed anon flag. Values given on
+// the command line come first, and an argument "-" yields the items read from
+// the input file descriptor (stdin by default). Items are only read and parsed
+// as the range is iterated, and each one is a bee::OrError with the parsing
+// result. The range is single pass, begin only reads the first item the first
+// time it's called and later calls resume at the current item.
+template <class S> struct AnonStream {
  public:
-  using parent = AnonFlagBase<S, RepeatedAnonFlagTemplate<S>>;
+  using value_type = typename S::value_type;
+  using item_type = bee::OrError<value_type>;
+
+  struct sentinel {};
+
+  struct iterator {
+   public:
+    using value_type = item_type;
+    using difference_type = std::ptrdiff_t;
 
-  const std::vector<typename S::value_type>& value() const
+    const item_type& operator*() const { return *_stream->_current; }
+    const item_type* operator->() const { return &*_stream->_current; }
+
+    iterator& operator++()
+    {
+      _stream->_advance();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    bool operator==(const sentinel&) const
+    {
+      return !_stream->_current.has_value();
+    }
+
+   private:
+    friend struct AnonStream;
+    explicit iterator(const AnonStream* stream) : _stream(stream) {}
+    const AnonStream* _stream;
+  };
+
+  AnonStream(const S& spec, int fd, char delimiter)
+      : _spec(spec), _fd(fd), _delimiter(delimiter)
+  {}
+
+  iterator begin() const
   {
-    return parent::value();
+    if (!_started) {
+      _started = true;
+      _advance();
+    }
+    return iterator(this);
   }
 
-  explicit RepeatedAnonFlagTemplate(
-    const S& spec, const opt_strview& value_name, const opt_strview& doc)
-      : parent(spec, value_name, doc, false, true)
+  sentinel end() const { return {}; }
+
+  void add_arg(const std::string_view& arg) { _args.push_back(arg); }
+
+ private:
+  void _advance() const
+  {
+    _current.reset();
+    while (true) {
+      if (_reader.has_value()) {
+        auto item = _reader->next();
+        if (item.is_error()) {
+          _current.emplace(item.error());
+          _reader.reset();
+          return;
+        }
+        if (item->has_value()) {
+          _current.emplace(_parse(**item));
+          return;
+        }
+        _reader.reset();
+      }
+      if (_next_arg == _args.size()) { return; }
+      const auto& arg = _args[_next_arg++];
+      if (arg == "-") {
+        _reader.emplace(_fd, _delimiter);
+      } else {
+        _current.emplace(_parse(arg));
+        return;
+      }
+    }
+  }
+
+  item_type _parse(const std::string_view& value) const
+  {
+    auto parsed = _spec.of_string(value);
+    if (parsed.is_error()) {
+      return bee::Error::fmt(
+        "Failed to parse anon flag with value '$': $", value, parsed.error());
+    }
+    return parsed;
+  }
+
+  const S _spec;
+  const int _fd;
+  const char _delimiter;
+  std::vector<std::string_view> _args;
+  mutable bool _started = false;
+  mutable size_t _next_arg = 0;
+  mutable std::optional<DelimitedReader> _reader;
+  mutable std::optional<item_type> _current;
+};
+
+template <class S> struct StreamedAnonFlagTemplate : public AnonFlag {
+ public:
+  // Items read from the input are overwritten as the stream advances
+  static_assert(
+    !std::is_same_v<typename S::value_type, std::string_view>,
+    "Streamed values can't point into the input, use a spec that copies");
+
+  using ptr = std::shared_ptr<StreamedAnonFlagTemplate>;
+
+  static ptr create(
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    int fd,
+    char delimiter,
+    MemoryResource* resource = default_resource())
+  {
+    return make_shared_in<StreamedAnonFlagTemplate>(resource, [&](void* mem) {
+      return new (mem) StreamedAnonFlagTemplate(
+        spec, value_name, doc, fd, delimiter, resource);
+    });
+  }
+
+  virtual bee::OrError<> parse_value(const std::string_view& value) override
+  {
+    _stream().add_arg(value);
+    return bee::ok();
+  }
+
+  virtual bee::OrError<> finish_parsing() const override { return bee::ok(); }
+
+  const AnonStream<S>& value() const { return _stream(); }
+
+ private:
+  explicit StreamedAnonFlagTemplate(
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    int fd,
+    char delimiter,
+    MemoryResource* resource)
+      : AnonFlag(value_name, doc, false, true, resource),
+        _spec(spec),
+        _fd(fd),
+        _delimiter(delimiter)
   {}
+
+  AnonStream<S>& _stream() const
+  {
+    return state<AnonStream<S>>(_spec, _fd, _delimiter);
+  }
+
+  const S _spec;
+  const int _fd;
+  const char _delimiter;
 };
 
-struct NamedFlag {
+struct NamedFlag : public Stateful {
  public:
-  explicit NamedFlag(const std::string_view& name, const opt_strview& doc);
+  explicit NamedFlag(
+    const std::string_view& name,
+    const opt_strview& doc,
+    MemoryResource* resource = default_resource());
 
   virtual ~NamedFlag();
 
-  const std::string& name() const;
+  // Views into the flag definition, valid while the flag is alive.
+  std::string_view name() const;
 
-  const opt_str& doc() const;
+  opt_strview doc() const;
 
   virtual FlagDoc make_doc() const = 0;
 
  private:
-  const std::string _name;
-  const opt_str _doc;
+  const std::pmr::string _name;
+  const opt_pmr_str _doc;
 };
 
 struct BooleanFlag : public NamedFlag {
  public:
   using ptr = std::shared_ptr<BooleanFlag>;
 
-  static ptr create(const std::string_view& name, const opt_strview& doc);
+  static ptr create(
+    const std::string_view& name,
+    const opt_strview& doc,
+    MemoryResource* resource = default_resource());
 
   virtual ~BooleanFlag();
 
-  void set();
+  virtual void set() const;
 
   const bool& value() const;
 
   virtual FlagDoc make_doc() const override;
 
- private:
-  explicit BooleanFlag(const std::string_view& name, const opt_strview& doc);
-
-  bool _value;
+ protected:
+  explicit BooleanFlag(
+    const std::string_view& name,
+    const opt_strview& doc,
+    MemoryResource* resource);
 };
 
 struct ValueFlag : public NamedFlag {
@@ -207,22 +464,31 @@ struct ValueFlag : public NamedFlag {
     const std::string_view& name,
     const opt_strview& value_name,
     const opt_strview& doc,
-    bool required);
+    bool required,
+    MemoryResource* resource = default_resource());
 
   virtual ~ValueFlag();
 
+  // When the invocation is lazy, see ParseState::is_lazy, only records the
+  // argument and the value is parsed the first time it's accessed. A parsing
+  // error at that point is thrown as a FlagValueError.
   virtual bee::OrError<> parse_value(const std::string_view& value) = 0;
 
   virtual bee::OrError<> finish_parsing() const = 0;
 
+  // Parses the value if it was stored unparsed by a lazy invocation.
+  virtual bee::OrError<> validate() const = 0;
+
   virtual FlagDoc make_doc() const override;
 
   bool is_required() const { return _required; }
 
+  opt_strview value_name() const;
+
   virtual opt_str default_str() const = 0;
 
  private:
-  const opt_str _value_name;
+  const opt_pmr_str _value_name;
   const bool _required;
 };
 
@@ -235,36 +501,69 @@ template <FlagSpec S> struct FlagTemplate : public ValueFlag {
     const std::string_view& name,
     const S& spec,
     const opt_strview& value_name,
-    const opt_strview& doc)
+    const opt_strview& doc,
+    MemoryResource* resource = default_resource())
   {
-    return ptr(new FlagTemplate(name, spec, value_name, doc, std::nullopt));
+    return make_shared_in<FlagTemplate>(resource, [&](void* mem) {
+      return new (mem) FlagTemplate(
+        name, spec, value_name, doc, std::nullopt, false, resource);
+    });
   }
 
   const std::optional<value_type>& value() const
   {
-    if (!_value.has_value()) {
+    auto& st = _state();
+    if (st.raw.has_value()) {
+      auto err = validate();
+      if (err.is_error()) { throw FlagValueError(err.error()); }
+    }
+    if (!st.value.has_value()) {
       return _def;
     } else {
-      return _value;
+      return st.value;
     }
   }
 
   virtual bee::OrError<> parse_value(const std::string_view& value) override
   {
+    auto& st = _state();
+    if (ParseState::current().is_lazy()) {
+      st.raw = value;
+      st.value.reset();
+      return bee::ok();
+    }
     bail(parsed_value, _spec.of_string(value));
-    _value.emplace(std::move(parsed_value));
+    st.value.emplace(std::move(parsed_value));
     return bee::ok();
   };
 
   virtual bee::OrError<> finish_parsing() const override
   {
-    if (is_required() && !value().has_value()) {
+    if (is_required() && !has_value()) {
       return bee::Error::fmt(
         "Flag $ is required, but not provided", this->name());
     }
     return bee::ok();
   }
 
+  virtual bee::OrError<> validate() const override
+  {
+    auto& st = _state();
+    if (!st.raw.has_value()) { return bee::ok(); }
+    Profiler::Span span("of_string", name());
+    auto parsed_value = _spec.of_string(*st.raw);
+    if (parsed_value.is_error()) {
+      return bee::Error::fmt(
+        "Failed to parse flag $ with value '$': $",
+        name(),
+        *st.raw,
+        parsed_value.error());
+    }
+    st.value.emplace(std::move(parsed_value.value()));
+    st.raw.reset();
+    return bee::ok();
+  }
+
   virtual opt_str default_str() const override
   {
     if (_def.has_value()) { return _spec.to_string(*_def); }
@@ -278,14 +577,30 @@ template <FlagSpec S> struct FlagTemplate : public ValueFlag {
     const opt_strview& value_name,
     const opt_strview& doc,
     const std::optional<value_type>& def,
-    bool required = false)
-      : ValueFlag(name, value_name, doc, required), _spec(spec), _def(def)
+    bool required,
+    MemoryResource* resource)
+      : ValueFlag(name, value_name, doc, required, resource),
+        _spec(spec),
+        _def(def)
   {}
 
+  bool has_value() const
+  {
+    const auto& st = _state();
+    return st.raw.has_value() || st.value.has_value() || _def.has_value();
+  }
+
  private:
+  // raw holds the argument given to a lazy invocation until it's parsed.
+  struct State {
+    std::optional<value_type> value;
+    std::optional<std::string_view> raw;
+  };
+
+  State& _state() const { return state<State>(); }
+
   const S _spec;
   const std::optional<value_type> _def;
-  std::optional<value_type> _value;
 };
 
 template <class S> struct RequiredFlagTemplate : public FlagTemplate<S> {
@@ -297,14 +612,18 @@ template <class S> struct RequiredFlagTemplate : public FlagTemplate<S> {
     const S& spec,
     const opt_strview& value_name,
     const opt_strview& doc,
-    const std::optional<value_type>& def = std::nullopt)
+    const std::optional<value_type>& def = std::nullopt,
+    MemoryResource* resource = default_resource())
   {
-    return ptr(new RequiredFlagTemplate(name, spec, value_name, doc, def));
+    return make_shared_in<RequiredFlagTemplate>(resource, [&](void* mem) {
+      return new (mem)
+        RequiredFlagTemplate(name, spec, value_name, doc, def, resource);
+    });
   }
 
   virtual bee::OrError<> finish_parsing() const override
   {
-    if (!FlagTemplate<S>::value().has_value()) {
+    if (!FlagTemplate<S>::has_value()) {
       return bee::Error::fmt(
         "Flag $ is required, but not provided", this->name());
     }
@@ -319,24 +638,260 @@ template <class S> struct RequiredFlagTemplate : public FlagTemplate<S> {
     const S& spec,
     const opt_strview& value_name,
     const opt_strview& doc,
-    const std::optional<value_type>& def)
-      : FlagTemplate<S>(name, spec, value_name, doc, def, !def.has_value())
+    const std::optional<value_type>& def,
+    MemoryResource* resource)
+      : FlagTemplate<S>(
+          name, spec, value_name, doc, def, !def.has_value(), resource)
+  {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Bound flags
+//
+// Flags that parse directly into a member of a struct, see StructBinding.
+// Each invocation gets its own instance of the struct, kept in a slot of the
+// ParseState. The member is either the value type of the spec or a
+// std::optional of it. Values are always parsed eagerly, and the initial value
+// of the member is shown as the default.
+//
+
+template <class T> struct is_std_optional : std::false_type {};
+template <class T>
+struct is_std_optional<std::optional<T>> : std::true_type {};
+
+template <class T, class M> struct BoundTarget {
+ public:
+  M& get() const { return ParseState::current().get<T>(object_slot).*member; }
+
+  M T::*member;
+  size_t object_slot;
+};
+
+template <class T> struct BoundBooleanFlag : public BooleanFlag {
+ public:
+  using ptr = std::shared_ptr<BoundBooleanFlag>;
+
+  static ptr create(
+    const std::string_view& name,
+    const opt_strview& doc,
+    const BoundTarget<T, bool>& target,
+    MemoryResource* resource = default_resource())
+  {
+    return make_shared_in<BoundBooleanFlag>(resource, [&](void* mem) {
+      return new (mem) BoundBooleanFlag(name, doc, target, resource);
+    });
+  }
+
+  virtual void set() const override
+  {
+    BooleanFlag::set();
+    _target.get() = true;
+  }
+
+ private:
+  explicit BoundBooleanFlag(
+    const std::string_view& name,
+    const opt_strview& doc,
+    const BoundTarget<T, bool>& target,
+    MemoryResource* resource)
+      : BooleanFlag(name, doc, resource), _target(target)
+  {}
+
+  const BoundTarget<T, bool> _target;
+};
+
+template <FlagSpec S, class T, class M>
+struct BoundFlagTemplate : public ValueFlag {
+ public:
+  using ptr = std::shared_ptr<BoundFlagTemplate>;
+  using value_type = typename S::value_type;
+
+  static_assert(
+    std::is_assignable_v<M&, value_type>,
+    "Flag spec value_type can't be assigned to the bound member");
+
+  static ptr create(
+    const std::string_view& name,
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    const BoundTarget<T, M>& target,
+    const M& initial,
+    bool required,
+    MemoryResource* resource = default_resource())
+  {
+    return make_shared_in<BoundFlagTemplate>(resource, [&](void* mem) {
+      return new (mem) BoundFlagTemplate(
+        name, spec, value_name, doc, target, initial, required, resource);
+    });
+  }
+
+  virtual bee::OrError<> parse_value(const std::string_view& value) override
+  {
+    bail(parsed_value, _spec.of_string(value));
+    _target.get() = std::move(parsed_value);
+    state<bool>() = true;
+    return bee::ok();
+  }
+
+  virtual bee::OrError<> finish_parsing() const override
+  {
+    if (is_required() && !state<bool>()) {
+      return bee::Error::fmt(
+        "Flag $ is required, but not provided", this->name());
+    }
+    return bee::ok();
+  }
+
+  virtual bee::OrError<> validate() const override { return bee::ok(); }
+
+  virtual opt_str default_str() const override { return _default_str; }
+
+ private:
+  explicit BoundFlagTemplate(
+    const std::string_view& name,
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    const BoundTarget<T, M>& target,
+    const M& initial,
+    bool required,
+    MemoryResource* resource)
+      : ValueFlag(name, value_name, doc, required, resource),
+        _spec(spec),
+        _target(target),
+        _default_str(required ? std::nullopt : make_default_str(spec, initial))
   {}
+
+  static opt_str make_default_str(const S& spec, const M& initial)
+  {
+    if constexpr (is_std_optional<M>::value) {
+      if (!initial.has_value()) { return std::nullopt; }
+      return spec.to_string(*initial);
+    } else {
+      return spec.to_string(initial);
+    }
+  }
+
+  const S _spec;
+  const BoundTarget<T, M> _target;
+  const opt_str _default_str;
+};
+
+// M is std::optional<value_type> for an optional flag, value_type for a
+// required flag, and std::vector<value_type> for a repeated flag.
+template <FlagSpec S, class T, class M>
+struct BoundAnonFlagTemplate : public AnonFlag {
+ public:
+  using ptr = std::shared_ptr<BoundAnonFlagTemplate>;
+  using value_type = typename S::value_type;
+
+  static constexpr bool repeated =
+    std::is_same_v<M, std::vector<value_type>>;
+
+  static_assert(
+    repeated || std::is_assignable_v<M&, value_type>,
+    "Flag spec value_type can't be assigned to the bound member");
+
+  static ptr create(
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    const BoundTarget<T, M>& target,
+    MemoryResource* resource = default_resource())
+  {
+    return make_shared_in<BoundAnonFlagTemplate>(resource, [&](void* mem) {
+      return new (mem)
+        BoundAnonFlagTemplate(spec, value_name, doc, target, resource);
+    });
+  }
+
+  virtual bee::OrError<> parse_value(const std::string_view& value) override
+  {
+    bool& provided = state<bool>();
+    if (!repeated && provided) { return bee::Error("Flag already set"); }
+    bail(parsed_value, _spec.of_string(value));
+    if constexpr (repeated) {
+      _target.get().push_back(std::move(parsed_value));
+    } else {
+      _target.get() = std::move(parsed_value);
+    }
+    provided = true;
+    return bee::ok();
+  }
+
+  virtual bee::OrError<> parse_values(
+    const bee::ArrayView<const std::string_view>& values,
+    size_t& parsed) override
+  {
+    if constexpr (repeated && HasOfStringMany<S>) {
+      auto& target = _target.get();
+      size_t before = target.size();
+      auto err = _spec.of_string_many(values, target);
+      parsed = target.size() - before;
+      if (parsed > 0) { state<bool>() = true; }
+      return err;
+    } else {
+      return AnonFlag::parse_values(values, parsed);
+    }
+  }
+
+  virtual bee::OrError<> finish_parsing() const override
+  {
+    return check_provided(state<bool>());
+  }
+
+ private:
+  explicit BoundAnonFlagTemplate(
+    const S& spec,
+    const opt_strview& value_name,
+    const opt_strview& doc,
+    const BoundTarget<T, M>& target,
+    MemoryResource* resource)
+      : AnonFlag(
+          value_name,
+          doc,
+          !repeated && !is_std_optional<M>::value,
+          repeated,
+          resource),
+        _spec(spec),
+        _target(target)
+  {}
+
+  const S _spec;
+  const BoundTarget<T, M> _target;
 };
 
 namespace flags {
 
 struct StringFlag {
   using value_type = std::string;
+  static constexpr bool is_identity = true;
   bee::OrError<value_type> of_string(const std::string_view& value) const;
   std::string to_string(const std::string_view& value) const;
 };
 
 constexpr StringFlag String;
 
+// Like String, but the value is a view of the argument itself instead of a
+// copy. Arguments given to Cmd::main point into argv, so the values stay valid
+// for the whole program. Arguments given to Cmd::execute are only valid while
+// the caller keeps them alive.
+struct StringViewFlag {
+  using value_type = std::string_view;
+  static constexpr bool is_identity = true;
+  bee::OrError<value_type> of_string(const std::string_view& value) const;
+  std::string to_string(const std::string_view& value) const;
+};
+
+constexpr StringViewFlag StringView;
+
 struct IntFlag {
   using value_type = int;
   bee::OrError<value_type> of_string(const std::string_view& value) const;
+  bee::OrError<> of_string_many(
+    const bee::ArrayView<const std::string_view>& values,
+    std::vector<value_type>& out) const;
   std::string to_string(int value) const;
 };
 
@@ -345,11 +900,117 @@ constexpr IntFlag Int;
 struct FloatFlag {
   using value_type = double;
   bee::OrError<value_type> of_string(const std::string_view& value) const;
-  std::string to_string(float value) const;
+  bee::OrError<> of_string_many(
+    const bee::ArrayView<const std::string_view>& values,
+    std::vector<value_type>& out) const;
+  std::string to_string(double value) const;
 };
 
 constexpr FloatFlag Float;
 
+// Numeric spec for any integer or floating point type, built on
+// std::from_chars. Errors are reported through bee::OrError without throwing,
+// and to_string produces the shortest representation that parses back to the
+// same value.
+template <class T>
+  requires std::is_arithmetic_v<T> && (!std::is_same_v<T, bool>)
+struct NumericFlag {
+  using value_type = T;
+
+  bee::OrError<value_type> of_string(const std::string_view& value) const
+  {
+    // from_chars doesn't take the leading plus that strtol and strtod do
+    std::string_view digits = value;
+    if (digits.size() > 1 && digits[0] == '+' && digits[1] != '-') {
+      digits.remove_prefix(1);
+    }
+    T parsed;
+    const char* end = digits.data() + digits.size();
+    auto result = std::from_chars(digits.data(), end, parsed);
+    // Also reported for floating point values too close to zero
+    if (result.ec == std::errc::result_out_of_range) {
+      return bee::Error("Number out of range");
+    } else if (result.ec != std::errc() || result.ptr != end) {
+      return bee::Error("Malformed number");
+    }
+    return parsed;
+  }
+
+  bee::OrError<> of_string_many(
+    const bee::ArrayView<const std::string_view>& values,
+    std::vector<value_type>& out) const
+  {
+    out.reserve(out.size() + values.size());
+    for (const auto& value : values) {
+      bail(parsed, of_string(value));
+      out.push_back(parsed);
+    }
+    return bee::ok();
+  }
+
+  std::string to_string(T value) const
+  {
+    char buf[64];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    return std::string(buf, result.ptr);
+  }
+};
+
+constexpr NumericFlag<int32_t> Int32;
+constexpr NumericFlag<int64_t> Int64;
+constexpr NumericFlag<uint64_t> UInt64;
+constexpr NumericFlag<size_t> Size;
+constexpr NumericFlag<float> Float32;
+
+// Delimiter separated list of values, each one parsed with spec. Elements are
+// parsed straight from views of the argument into the resulting vector. An
+// empty argument is an empty list.
+template <FlagSpec S> struct ListFlag {
+  using value_type = std::vector<typename S::value_type>;
+
+  bee::OrError<value_type> of_string(const std::string_view& value) const
+  {
+    value_type out;
+    if (value.empty()) { return out; }
+    out.reserve(std::count(value.begin(), value.end(), delimiter) + 1);
+    size_t begin = 0;
+    while (true) {
+      size_t end = value.find(delimiter, begin);
+      auto element = value.substr(begin, end - begin);
+      auto parsed = spec.of_string(element);
+      if (parsed.is_error()) {
+        return bee::Error::fmt(
+          "Invalid list element '$': $", element, parsed.error());
+      }
+      out.push_back(std::move(parsed.value()));
+      if (end == std::string_view::npos) { break; }
+      begin = end + 1;
+    }
+    return out;
+  }
+
+  std::string to_string(const value_type& value) const
+  {
+    std::string out;
+    bool first = true;
+    for (const auto& element : value) {
+      if (!first) { out += delimiter; }
+      first = false;
+      out += spec.to_string(element);
+    }
+    return out;
+  }
+
+  S spec;
+  char delimiter;
+};
+
+template <FlagSpec S>
+constexpr ListFlag<S> List(const S& spec, char delimiter = ',')
+{
+  return ListFlag<S>{.spec = spec, .delimiter = delimiter};
+}
+
 } // namespace flags
 
 using Flag = std::variant<ValueFlag::ptr, BooleanFlag::ptr>;
@@ -0,0 +1,315 @@
+#include "completion.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bee/print.hpp"
+
+namespace command {
+namespace {
+
+constexpr std::string_view cache_suffix = ".complete";
+constexpr std::string_view header_prefix = "command-completion-index 1";
+
+void add_lines(
+  const CompletionTree& tree,
+  const std::string& path,
+  std::vector<std::string>& lines,
+  std::vector<std::string>& inputs)
+{
+  inputs.insert(inputs.end(), tree.inputs.begin(), tree.inputs.end());
+  for (const auto& flag : tree.flags) {
+    auto line = path + "\tf" + flag.name;
+    if (flag.value_name.has_value()) { line += "\t" + *flag.value_name; }
+    lines.push_back(std::move(line));
+  }
+  for (const auto& subcommand : tree.subcommands) {
+    lines.push_back(path + "\tc" + subcommand.name);
+    add_lines(
+      subcommand.tree,
+      path.empty() ? subcommand.name : path + " " + subcommand.name,
+      lines,
+      inputs);
+  }
+}
+
+// The sorted entries of an index, without its header.
+struct Entries {
+ public:
+  explicit Entries(const std::string_view& index)
+  {
+    size_t end = index.find('\n');
+    _body = end == std::string_view::npos ? std::string_view()
+                                          : index.substr(end + 1);
+  }
+
+  // Entries that start with key, in order.
+  std::vector<std::string_view> starting_with(
+    const std::string_view& key) const
+  {
+    std::vector<std::string_view> out;
+    for (size_t pos = _lower_bound(key); pos < _body.size();) {
+      auto line = _line_at(pos);
+      if (!line.starts_with(key)) { break; }
+      out.push_back(line);
+      pos += line.size() + 1;
+    }
+    return out;
+  }
+
+ private:
+  std::string_view _line_at(size_t start) const
+  {
+    size_t end = std::min(_body.find('\n', start), _body.size());
+    return _body.substr(start, end - start);
+  }
+
+  // Offset of the first line not less than key. Every offset in [low, high]
+  // that follows a newline is a line start, so the lines in between can be
+  // bisected in place.
+  size_t _lower_bound(const std::string_view& key) const
+  {
+    size_t low = 0;
+    size_t high = _body.size();
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      size_t start = mid;
+      while (start > low && _body[start - 1] != '\n') { start--; }
+      auto line = _line_at(start);
+      if (line < key) {
+        low = start + line.size() + 1;
+      } else {
+        high = start;
+      }
+    }
+    return std::min(low, _body.size());
+  }
+
+  std::string_view _body;
+};
+
+std::string join_path(const std::string& path, const std::string_view& word)
+{
+  return path.empty() ? std::string(word) : path + " " + std::string(word);
+}
+
+std::string key(
+  const std::string& path, char kind, const std::string_view& name)
+{
+  std::string out = path;
+  out += '\t';
+  out += kind;
+  out += name;
+  return out;
+}
+
+// The name of an entry, without the path, kind and value name.
+std::string_view entry_name(const std::string_view& entry)
+{
+  auto name = entry.substr(entry.find('\t') + 2);
+  return name.substr(0, name.find('\t'));
+}
+
+std::optional<std::string> executable_path()
+{
+  char buffer[4096];
+  ssize_t n = readlink("/proc/self/exe", buffer, sizeof(buffer));
+  if (n <= 0 || size_t(n) == sizeof(buffer)) { return std::nullopt; }
+  return std::string(buffer, n);
+}
+
+// Size and modification time of a file, which change when it's rewritten.
+std::optional<std::string> file_stamp(const std::string& path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) { return std::nullopt; }
+  return std::to_string(st.st_size) + " " +
+         std::to_string(st.st_mtim.tv_sec) + "." +
+         std::to_string(st.st_mtim.tv_nsec);
+}
+
+// Identifies the build of the binary, an index made by another one is stale.
+std::optional<std::string> make_header(const std::string& exe)
+{
+  auto stamp = file_stamp(exe);
+  if (!stamp.has_value()) { return std::nullopt; }
+  return std::string(header_prefix) + " " + *stamp;
+}
+
+void print_candidates(
+  const std::string_view& index,
+  const bee::ArrayView<const std::string_view> words)
+{
+  for (const auto& candidate : complete(index, words)) { P("$", candidate); }
+}
+
+void write_cache(const std::string& path, const std::string& index)
+{
+  // Written aside and renamed, so concurrent completions never read a partial
+  // file
+  auto tmp = path + "." + std::to_string(getpid());
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) { return; }
+  bool ok = true;
+  for (size_t written = 0; ok && written < index.size();) {
+    ssize_t n = write(fd, index.data() + written, index.size() - written);
+    if (n == -1 && errno == EINTR) { continue; }
+    ok = n > 0;
+    if (ok) { written += n; }
+  }
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) { unlink(tmp.c_str()); }
+}
+
+} // namespace
+
+std::string make_completion_index(
+  const CommandBase& cmd, const std::string_view& header)
+{
+  CompletionTree tree;
+  cmd.describe(tree);
+  std::vector<std::string> lines;
+  std::vector<std::string> inputs;
+  add_lines(tree, "", lines, inputs);
+  std::sort(lines.begin(), lines.end());
+
+  // The inputs follow the header as <size> <mtime> <path>, tab separated
+  std::string index(header);
+  for (const auto& input : inputs) {
+    index += '\t';
+    index += file_stamp(input).value_or("- -");
+    index += ' ';
+    index += input;
+  }
+  index += '\n';
+  for (const auto& line : lines) {
+    index += line;
+    index += '\n';
+  }
+  return index;
+}
+
+std::vector<std::string_view> complete(
+  const std::string_view& index,
+  const bee::ArrayView<const std::string_view> words)
+{
+  if (words.empty()) { return {}; }
+  Entries entries(index);
+
+  // Follow the subcommands, then skip over the flags and their values
+  std::string path;
+  size_t i = 0;
+  for (; i + 1 < words.size(); i++) {
+    auto child = entries.starting_with(key(path, 'c', words[i]));
+    if (std::none_of(child.begin(), child.end(), [&](auto entry) {
+          return entry_name(entry) == words[i];
+        })) {
+      break;
+    }
+    path = join_path(path, words[i]);
+  }
+  bool is_group = !entries.starting_with(key(path, 'c', "")).empty();
+  if (is_group && i + 1 < words.size()) { return {}; }
+
+  bool expects_value = false;
+  for (; i + 1 < words.size(); i++) {
+    const auto& word = words[i];
+    if (expects_value) {
+      expects_value = false;
+    } else if (word.starts_with('-') && word.find('=') == word.npos) {
+      for (const auto& entry : entries.starting_with(key(path, 'f', word))) {
+        if (entry_name(entry) == word) {
+          expects_value = entry.size() > key(path, 'f', word).size();
+        }
+      }
+    }
+  }
+
+  const auto& prefix = words[words.size() - 1];
+  std::vector<std::string_view> candidates;
+  if (expects_value) { return candidates; }
+  char kind = is_group ? 'c' : 'f';
+  if (kind == 'f' && !prefix.empty() && !prefix.starts_with('-')) {
+    return candidates;
+  }
+  for (const auto& entry : entries.starting_with(key(path, kind, prefix))) {
+    candidates.push_back(entry_name(entry));
+  }
+  return candidates;
+}
+
+bool index_is_current(
+  const std::string_view& index, const std::string_view& header)
+{
+  auto line = index.substr(0, index.find('\n'));
+  size_t end = std::min(line.find('\t'), line.size());
+  if (line.substr(0, end) != header) { return false; }
+  while (end < line.size()) {
+    size_t begin = end + 1;
+    end = std::min(line.find('\t', begin), line.size());
+    auto field = line.substr(begin, end - begin);
+    size_t path = field.find(' ', field.find(' ') + 1);
+    if (path == std::string_view::npos) { return false; }
+    auto stamp = file_stamp(std::string(field.substr(path + 1)));
+    if (!stamp.has_value() || *stamp != field.substr(0, path)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::optional<int> complete_from_cache(int argc, const char* const* argv)
+{
+  if (argc < 2 || std::string_view(argv[1]) != complete_command) {
+    return std::nullopt;
+  }
+  auto exe = executable_path();
+  if (!exe.has_value()) { return std::nullopt; }
+  auto header = make_header(*exe);
+  if (!header.has_value()) { return std::nullopt; }
+
+  int fd = open((*exe + std::string(cache_suffix)).c_str(), O_RDONLY);
+  if (fd == -1) { return std::nullopt; }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return std::nullopt;
+  }
+  size_t size = st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) { return std::nullopt; }
+
+  std::string_view index(static_cast<const char*>(data), size);
+  std::optional<int> exit_code;
+  if (index_is_current(index, *header)) {
+    std::vector<std::string_view> words(argv + 2, argv + argc);
+    print_candidates(index, bee::ArrayView<const std::string_view>(words));
+    exit_code = 0;
+  }
+  munmap(data, size);
+  return exit_code;
+}
+
+int complete_and_cache(
+  const CommandBase& cmd, const bee::ArrayView<const std::string_view> words)
+{
+  auto exe = executable_path();
+  std::optional<std::string> header;
+  if (exe.has_value()) { header = make_header(*exe); }
+
+  auto index = make_completion_index(cmd, header.value_or(""));
+  if (header.has_value()) {
+    write_cache(*exe + std::string(cache_suffix), index);
+  }
+  print_candidates(index, words);
+  return 0;
+}
+
+} // namespace command
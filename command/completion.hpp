@@ -0,0 +1,61 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "command_base.hpp"
+
+#include "bee/array_view.hpp"
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Shell completion. Shells run `<tool> __complete <words...>`, where the last
+// word is the one being completed (possibly empty), and get one candidate per
+// line on stdout.
+//
+// Answers come from an index of every subcommand and flag in the tree. It's a
+// text file with a header line followed by sorted lines of
+//
+//   <path>\t<kind><name>[\t<value name>]
+//
+// where path is the subcommand names leading to a command, separated by
+// spaces, and kind is c for subcommands and f for flags, so completions are
+// found with a binary search over the file, without parsing it.
+//
+// Cmd::main answers __complete by walking the tree and caches the index next
+// to the binary, as <binary>.complete. Tools call complete_from_cache first
+// thing in main, before building their tree, so later completions are
+// answered without building any command. The cache is refreshed when the
+// binary changes, or one of the files the tree was read from (schemas, plugin
+// manifests, see CompletionTree::inputs). Lazy commands are not built to be
+// described, only their names are completed.
+
+// Builds the index of cmd, the header records the binary it was built for.
+// The inputs of the tree are recorded after it, with their size and
+// modification time.
+std::string make_completion_index(
+  const CommandBase& cmd, const std::string_view& header = "");
+
+// Whether index was built with header and none of its inputs changed since.
+bool index_is_current(
+  const std::string_view& index, const std::string_view& header);
+
+// Candidates for the last of words, the ones before it select the command.
+std::vector<std::string_view> complete(
+  const std::string_view& index, bee::ArrayView<const std::string_view> words);
+
+// If argv is a __complete request and the cached index is up to date with the
+// binary, answers it and returns the exit code.
+std::optional<int> complete_from_cache(int argc, const char* const* argv);
+
+// Answers a __complete request from cmd and refreshes the cached index. Errors
+// writing the cache are ignored.
+int complete_and_cache(
+  const CommandBase& cmd, bee::ArrayView<const std::string_view> words);
+
+inline constexpr char complete_command[] = "__complete";
+
+} // namespace command
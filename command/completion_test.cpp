@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "command_builder.hpp"
+#include "completion.hpp"
+#include "group_builder.hpp"
+
+#include "bee/format_vector.hpp"
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace command {
+namespace {
+
+Cmd make_app(int& lazy_builds)
+{
+  auto leaf = [](const string& description) {
+    auto builder = CommandBuilder(description);
+    builder.no_arg("--dry-run");
+    builder.optional("--timeout", flags::Int, "seconds");
+    builder.optional("--tag", flags::String);
+    builder.repeated_anon(flags::String, "services");
+    return builder.run([]() { return bee::ok(); });
+  };
+  auto remote = GroupBuilder("Remote commands")
+                  .cmd("add", leaf("Adds a remote"))
+                  .cmd("remove", leaf("Removes a remote"))
+                  .build();
+  return GroupBuilder("Tool")
+    .cmd("deploy", leaf("Deploys"))
+    .cmd("describe", leaf("Describes"))
+    .cmd("remote", remote)
+    .lazy_cmd(
+      "lazy",
+      "Built on demand",
+      [&]() {
+        lazy_builds++;
+        return leaf("Lazy");
+      })
+    .build();
+}
+
+TEST(index)
+{
+  int lazy_builds = 0;
+  auto app = make_app(lazy_builds);
+  auto index = make_completion_index(*app.base(), "header");
+  P(index);
+  P("lazy builds: $", lazy_builds);
+}
+
+TEST(complete)
+{
+  int lazy_builds = 0;
+  auto app = make_app(lazy_builds);
+  auto index = make_completion_index(*app.base(), "header");
+
+  auto run = [&](const vector<string_view>& words) {
+    auto candidates =
+      complete(index, bee::ArrayView<const string_view>(words));
+    P("$ -> $",
+      vector<string>(words.begin(), words.end()),
+      vector<string>(candidates.begin(), candidates.end()));
+  };
+  run({""});
+  run({"de"});
+  run({"deploy"});
+  run({"remote", ""});
+  run({"remote", "re"});
+  run({"remote", "add", ""});
+  run({"remote", "add", "--t"});
+  run({"remote", "add", "--timeout", ""});
+  run({"remote", "add", "--timeout", "5", "--d"});
+  run({"remote", "add", "--timeout=5", "--d"});
+  run({"remote", "add", "web", ""});
+  run({"remote", "add", "we"});
+  run({"nope", ""});
+  run({"lazy", "--"});
+  run({});
+}
+
+TEST(inputs)
+{
+  const string path = "completion_test_manifest";
+  auto write = [&](const string& content) {
+    std::ofstream(path, std::ios::binary) << content;
+  };
+  write("first");
+  auto app = GroupBuilder("Tool")
+               .cmd("deploy", CommandBuilder("Deploys").run([]() {
+                 return bee::ok();
+               }))
+               .completion_input(path)
+               .build();
+  auto index = make_completion_index(*app.base(), "header");
+  auto line = index.substr(0, index.find('\n'));
+  P("header records the input: $", line.ends_with(" " + path));
+  P("current: $", index_is_current(index, "header"));
+  P("other header: $", index_is_current(index, "other"));
+
+  write("changed");
+  P("after the input changed: $", index_is_current(index, "header"));
+  std::remove(path.c_str());
+  P("after the input was removed: $", index_is_current(index, "header"));
+}
+
+} // namespace
+} // namespace command
@@ -0,0 +1,434 @@
+#include "daemon.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "command_builder.hpp"
+#include "io_util.hpp"
+
+#include "bee/print.hpp"
+
+namespace command {
+namespace {
+
+// A request is a header followed by the arguments, each NUL terminated. The
+// client's stdin, stdout, stderr and working directory travel with the header
+// as SCM_RIGHTS. The reply is the exit code.
+struct RequestHeader {
+  uint32_t payload_size;
+};
+
+constexpr int num_stdio_fds = 3;
+constexpr int cwd_fd_index = num_stdio_fds;
+constexpr int num_client_fds = num_stdio_fds + 1;
+constexpr uint32_t max_payload_size = 64 << 20;
+
+bee::Error errno_error(const char* what)
+{
+  return bee::Error::fmt("$: $", what, strerror(errno));
+}
+
+bee::OrError<sockaddr_un> make_address(const std::string& socket_path)
+{
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    return bee::Error::fmt("Socket path too long: $", socket_path);
+  }
+  std::memcpy(addr.sun_path, socket_path.data(), socket_path.size());
+  return addr;
+}
+
+// Whether path is still the socket identified by id
+bool is_socket(const std::string& path, const SocketId& id)
+{
+  struct stat st;
+  return lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) &&
+         st.st_dev == id.dev && st.st_ino == id.ino;
+}
+
+bee::OrError<> set_timeout(int fd, const std::chrono::milliseconds& timeout)
+{
+  timeval tv{
+    .tv_sec = time_t(timeout.count() / 1000),
+    .tv_usec = suseconds_t(timeout.count() % 1000 * 1000),
+  };
+  for (int option : {SO_RCVTIMEO, SO_SNDTIMEO}) {
+    if (setsockopt(fd, SOL_SOCKET, option, &tv, sizeof(tv)) == -1) {
+      return errno_error("Failed to set socket timeout");
+    }
+  }
+  return bee::ok();
+}
+
+bee::OrError<> check_peer(int conn)
+{
+  ucred cred;
+  socklen_t len = sizeof(cred);
+  if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+    return errno_error("Failed to get peer credentials");
+  }
+  if (cred.uid != geteuid()) {
+    return bee::Error::fmt("Rejected client running as uid $", cred.uid);
+  }
+  return bee::ok();
+}
+
+bee::OrError<> write_all(int fd, const void* data, size_t size)
+{
+  auto ptr = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t n = send(fd, ptr, size, MSG_NOSIGNAL);
+    if (n == -1) {
+      if (errno == EINTR) { continue; }
+      return errno_error("Failed to write to socket");
+    }
+    ptr += n;
+    size -= n;
+  }
+  return bee::ok();
+}
+
+bee::OrError<> read_all(int fd, void* data, size_t size)
+{
+  auto ptr = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t n = recv(fd, ptr, size, 0);
+    if (n == -1) {
+      if (errno == EINTR) { continue; }
+      return errno_error("Failed to read from socket");
+    }
+    if (n == 0) { return bee::Error("Connection closed unexpectedly"); }
+    ptr += n;
+    size -= n;
+  }
+  return bee::ok();
+}
+
+struct ClientFds {
+ public:
+  ClientFds() = default;
+  ClientFds(const ClientFds&) = delete;
+  ClientFds& operator=(const ClientFds&) = delete;
+  ~ClientFds()
+  {
+    for (int fd : fds) {
+      if (fd != -1) { close(fd); }
+    }
+  }
+
+  int fds[num_client_fds] = {-1, -1, -1, -1};
+};
+
+bee::OrError<RequestHeader> read_header(int conn, ClientFds& client_fds)
+{
+  RequestHeader header;
+  iovec iov{.iov_base = &header, .iov_len = sizeof(header)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * num_client_fds)];
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+  } while (n == -1 && errno == EINTR);
+  if (n == -1) { return errno_error("Failed to read request"); }
+
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (size_t i = 0; i < count && i < num_client_fds; i++) {
+        std::memcpy(
+          &client_fds.fds[i], CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      }
+    }
+  }
+
+  if (size_t(n) != sizeof(header)) { return bee::Error("Truncated request"); }
+  for (int fd : client_fds.fds) {
+    if (fd == -1) {
+      return bee::Error("Request without stdio and working directory");
+    }
+  }
+  if (header.payload_size > max_payload_size) {
+    return bee::Error("Request too large");
+  }
+  return header;
+}
+
+// Points the standard file descriptors at the client's until destroyed.
+struct StdioSwap {
+ public:
+  explicit StdioSwap(const ClientFds& client)
+  {
+    io_util::flush_output();
+    for (int i = 0; i < num_stdio_fds; i++) {
+      _saved[i] = dup(i);
+      dup2(client.fds[i], i);
+    }
+  }
+
+  ~StdioSwap()
+  {
+    io_util::flush_output();
+    for (int i = 0; i < num_stdio_fds; i++) {
+      dup2(_saved[i], i);
+      close(_saved[i]);
+    }
+  }
+
+  StdioSwap(const StdioSwap&) = delete;
+  StdioSwap& operator=(const StdioSwap&) = delete;
+
+ private:
+  int _saved[num_stdio_fds];
+};
+
+// Changes the working directory to the client's until destroyed, so relative
+// paths in the arguments resolve like they would in the client.
+struct CwdSwap {
+ public:
+  CwdSwap() = default;
+
+  ~CwdSwap()
+  {
+    if (_saved == -1) { return; }
+    if (fchdir(_saved) == -1) {
+      PF(
+        bee::LogOutput::StdErr,
+        "Failed to restore working directory: $",
+        strerror(errno));
+    }
+    close(_saved);
+  }
+
+  CwdSwap(const CwdSwap&) = delete;
+  CwdSwap& operator=(const CwdSwap&) = delete;
+
+  bee::OrError<> enter(int dir_fd)
+  {
+    _saved = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (_saved == -1) {
+      return errno_error("Failed to open working directory");
+    }
+    if (fchdir(dir_fd) == -1) {
+      return errno_error("Failed to enter the client's working directory");
+    }
+    return bee::ok();
+  }
+
+ private:
+  int _saved = -1;
+};
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// Server
+//
+
+Server::Server(
+  int fd,
+  const std::string& socket_path,
+  const SocketId& id,
+  const std::chrono::milliseconds& request_timeout)
+    : _fd(fd),
+      _socket_path(socket_path),
+      _id(id),
+      _request_timeout(request_timeout)
+{}
+
+Server::~Server()
+{
+  close(_fd);
+  // Someone else may have taken the path over since
+  if (is_socket(_socket_path, _id)) { unlink(_socket_path.c_str()); }
+}
+
+bee::OrError<Server::ptr> Server::listen(
+  const std::string& socket_path,
+  const std::chrono::milliseconds& request_timeout)
+{
+  bail(addr, make_address(socket_path));
+  struct stat st;
+  if (lstat(socket_path.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      return bee::Error::fmt(
+        "Refusing to replace $, it exists and is not a socket", socket_path);
+    }
+    if (unlink(socket_path.c_str()) == -1) {
+      return errno_error("Failed to remove stale socket");
+    }
+  } else if (errno != ENOENT) {
+    return errno_error("Failed to stat socket path");
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) { return errno_error("Failed to create socket"); }
+  if (
+    bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1 ||
+    chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) == -1 ||
+    lstat(socket_path.c_str(), &st) == -1 ||
+    ::listen(fd, SOMAXCONN) == -1) {
+    auto err = errno_error("Failed to listen on socket");
+    close(fd);
+    return err;
+  }
+  return ptr(new Server(
+    fd, socket_path, {.dev = st.st_dev, .ino = st.st_ino}, request_timeout));
+}
+
+bee::OrError<> Server::run(const Cmd& cmd, std::optional<size_t> max_requests)
+{
+  size_t handled = 0;
+  while (!max_requests.has_value() || handled < *max_requests) {
+    int conn = accept4(_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) { continue; }
+      return errno_error("Failed to accept connection");
+    }
+    auto err = _handle(cmd, conn);
+    handled++;
+    close(conn);
+    if (err.is_error()) {
+      PF(bee::LogOutput::StdErr, "Failed to handle request: $", err.error());
+    }
+  }
+  return bee::ok();
+}
+
+bee::OrError<> Server::_handle(const Cmd& cmd, int conn)
+{
+  bail_unit(check_peer(conn));
+  bail_unit(set_timeout(conn, _request_timeout));
+  ClientFds client_fds;
+  bail(header, read_header(conn, client_fds));
+  std::string payload(header.payload_size, '\0');
+  bail_unit(read_all(conn, payload.data(), payload.size()));
+
+  std::vector<std::string_view> args;
+  for (size_t begin = 0; begin < payload.size();) {
+    size_t end = payload.find('\0', begin);
+    if (end == std::string::npos) { return bee::Error("Malformed request"); }
+    args.emplace_back(payload.data() + begin, end - begin);
+    begin = end + 1;
+  }
+
+  int32_t exit_code;
+  {
+    CwdSwap cwd;
+    bail_unit(cwd.enter(client_fds.fds[cwd_fd_index]));
+    StdioSwap swap(client_fds);
+    try {
+      exit_code = cmd.execute(
+        bee::LogOutput::StdErr,
+        bee::ArrayView<const std::string_view>(args.data(), args.size()));
+    } catch (const std::exception& exn) {
+      // Handlers are not allowed to take the server down with them
+      PF(bee::LogOutput::StdErr, "Application exited with error:");
+      PF(bee::LogOutput::StdErr, exn.what());
+      exit_code = 1;
+    }
+  }
+  return write_all(conn, &exit_code, sizeof(exit_code));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Client
+//
+
+bee::OrError<int> call_server(
+  const std::string& socket_path,
+  const bee::ArrayView<const std::string_view> args)
+{
+  bail(addr, make_address(socket_path));
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) { return errno_error("Failed to create socket"); }
+  auto result = [&]() -> bee::OrError<int> {
+    if (
+      connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) ==
+      -1) {
+      return bee::Error::fmt(
+        "Failed to connect to $: $", socket_path, strerror(errno));
+    }
+
+    std::string payload;
+    for (const auto& arg : args) {
+      payload += arg;
+      payload += '\0';
+    }
+    RequestHeader header{.payload_size = uint32_t(payload.size())};
+
+    int cwd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (cwd == -1) { return errno_error("Failed to open working directory"); }
+    int client_fds[num_client_fds] = {
+      STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, cwd};
+
+    iovec iov{.iov_base = &header, .iov_len = sizeof(header)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * num_client_fds)]{};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_client_fds);
+    std::memcpy(CMSG_DATA(cmsg), client_fds, sizeof(client_fds));
+
+    io_util::flush_output();
+    ssize_t n;
+    do {
+      n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+    if (n != sizeof(header)) {
+      auto err = errno_error("Failed to send request");
+      close(cwd);
+      return err;
+    }
+    close(cwd);
+    bail_unit(write_all(fd, payload.data(), payload.size()));
+
+    int32_t exit_code;
+    bail_unit(read_all(fd, &exit_code, sizeof(exit_code)));
+    return exit_code;
+  }();
+  close(fd);
+  return result;
+}
+
+Cmd serve_command(const Cmd& target, MemoryResource* resource)
+{
+  auto builder = CommandBuilder("Serves commands over a Unix socket", resource);
+  auto socket_path = builder.required(
+    "--socket", flags::String, "path", "Path of the socket to listen on");
+  auto max_requests = builder.optional(
+    "--max-requests",
+    flags::Int,
+    "count",
+    "Exit after handling this many requests");
+  return builder.run([=]() -> bee::OrError<> {
+    if (max_requests->has_value() && **max_requests < 0) {
+      return bee::Error("--max-requests must not be negative");
+    }
+    bail(server, Server::listen(*socket_path));
+    return server->run(target, *max_requests);
+  });
+}
+
+} // namespace command
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "arena.hpp"
+#include "cmd.hpp"
+
+#include "bee/array_view.hpp"
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Identifies a socket file by device and inode.
+struct SocketId {
+ public:
+  uint64_t dev;
+  uint64_t ino;
+};
+
+// Runs commands on behalf of clients connected to a Unix socket, so a
+// long-running process can keep the command tree and whatever state its
+// handlers build (indexes, caches) warm across calls.
+//
+// A request carries the client's argv, its stdin, stdout and stderr file
+// descriptors and its working directory. The server points its own standard
+// file descriptors at the client's and changes to the client's working
+// directory while it runs the command, so handlers print straight to the
+// client's terminal or pipes and relative paths resolve like they would in
+// the client, and replies with the exit code.
+//
+// Requests are served one at a time, in the order they are accepted, so a
+// client that connects and stalls holds up everyone behind it. Reading the
+// request and writing the reply time out after request_timeout to bound that;
+// the command itself is not timed out.
+//
+// Anyone who can connect runs commands with the server's privileges. The
+// socket file is only accessible to its owner and clients running as another
+// user are rejected, so only the server's own user may connect. Put the socket
+// in a directory that other users cannot write to.
+struct Server {
+ public:
+  using ptr = std::unique_ptr<Server>;
+
+  static constexpr std::chrono::milliseconds default_request_timeout =
+    std::chrono::seconds(10);
+
+  // Binds and listens on socket_path, replacing a stale socket file. Fails
+  // rather than remove anything at socket_path that isn't a socket.
+  static bee::OrError<ptr> listen(
+    const std::string& socket_path,
+    const std::chrono::milliseconds& request_timeout =
+      default_request_timeout);
+
+  ~Server();
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // Serves requests until max_requests have been handled, or forever.
+  bee::OrError<> run(
+    const Cmd& cmd, std::optional<size_t> max_requests = std::nullopt);
+
+ private:
+  Server(
+    int fd,
+    const std::string& socket_path,
+    const SocketId& id,
+    const std::chrono::milliseconds& request_timeout);
+
+  bee::OrError<> _handle(const Cmd& cmd, int conn);
+
+  const int _fd;
+  const std::string _socket_path;
+
+  // The socket file this server created, only that one is removed on exit
+  const SocketId _id;
+
+  const std::chrono::milliseconds _request_timeout;
+};
+
+// Sends args, along with this process' stdin, stdout and stderr, to the server
+// listening on socket_path and waits for the command to finish. Returns the
+// exit code of the command.
+bee::OrError<int> call_server(
+  const std::string& socket_path, bee::ArrayView<const std::string_view> args);
+
+// A command that serves target until killed, listening on the socket given with
+// --socket. GroupBuilder::serve adds one that serves the group itself.
+Cmd serve_command(
+  const Cmd& target, MemoryResource* resource = default_resource());
+
+} // namespace command
@@ -0,0 +1,160 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "command_builder.hpp"
+#include "daemon.hpp"
+#include "group_builder.hpp"
+
+#include "bee/file_writer.hpp"
+#include "bee/format_vector.hpp"
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace command {
+namespace {
+
+constexpr char socket_path[] = "daemon_test.sock";
+
+Cmd make_app()
+{
+  // State built by the first call is still there for the following ones
+  auto calls = std::make_shared<int>(0);
+
+  auto builder = CommandBuilder("Greets");
+  auto name = builder.required("--name", flags::String);
+  auto greet = builder.run([=]() -> bee::OrError<> {
+    ++*calls;
+    P("Hello $, call number $", *name, *calls);
+    if (*name == "nobody") { return bee::Error("Nobody to greet"); }
+    return bee::ok();
+  });
+  return GroupBuilder("App").cmd("greet", greet).serve().build();
+}
+
+void call(const vector<string_view>& args, const string& path = socket_path)
+{
+  P("args: $", vector<string>(args.begin(), args.end()));
+  auto exit_code = call_server(path, bee::ArrayView<const string_view>(args));
+  P("exit_code: $", exit_code);
+  P("------------------------------------");
+}
+
+TEST(serve)
+{
+  // Errors are printed to the client's stderr, show them inline
+  std::ignore = bee::FileWriter::stdout().flush();
+  dup2(STDOUT_FILENO, STDERR_FILENO);
+
+  auto app = make_app();
+  auto server = Server::listen(socket_path).value();
+  std::thread thread([&] { server->run(app, 5).value(); });
+
+  call({"greet", "--name", "world"});
+  call({"greet", "--name", "again"});
+  call({"greet", "--name", "nobody"});
+  call({"greet"});
+  call({"help"});
+
+  thread.join();
+  server.reset();
+
+  P("After shutdown:");
+  call({"greet", "--name", "world"});
+}
+
+TEST(refuses_to_replace_other_files)
+{
+  FILE* file = fopen(socket_path, "w");
+  fputs("precious", file);
+  fclose(file);
+
+  P(Server::listen(socket_path).error());
+
+  char content[16] = {};
+  file = fopen(socket_path, "r");
+  std::ignore = fread(content, 1, sizeof(content) - 1, file);
+  fclose(file);
+  P("Still there: $", content);
+  unlink(socket_path);
+}
+
+TEST(stalled_client)
+{
+  std::ignore = bee::FileWriter::stdout().flush();
+  dup2(STDOUT_FILENO, STDERR_FILENO);
+
+  auto app = make_app();
+  auto server =
+    Server::listen(socket_path, std::chrono::milliseconds(100)).value();
+  std::thread thread([&] { server->run(app, 2).value(); });
+
+  // Connects and never sends its request
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+  int stalled = socket(AF_UNIX, SOCK_STREAM, 0);
+  connect(stalled, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+
+  call({"greet", "--name", "world"});
+  thread.join();
+  close(stalled);
+}
+
+TEST(client_working_directory)
+{
+  auto builder = CommandBuilder("Prints a file");
+  auto path = builder.required_anon(flags::String, "path");
+  auto cat = builder.run([=]() -> bee::OrError<> {
+    FILE* file = fopen(path->c_str(), "r");
+    if (file == nullptr) { return bee::Error::fmt("Can't open $", *path); }
+    char content[64] = {};
+    std::ignore = fread(content, 1, sizeof(content) - 1, file);
+    fclose(file);
+    P("Read: $", content);
+    return bee::ok();
+  });
+  auto app = GroupBuilder("App").cmd("cat", cat).build();
+
+  mkdir("daemon_test_dir", 0700);
+  FILE* file = fopen("daemon_test_dir/note", "w");
+  fputs("from the client's directory", file);
+  fclose(file);
+
+  // The working directory is per process, so the server runs in another one
+  std::ignore = bee::FileWriter::stdout().flush();
+  dup2(STDOUT_FILENO, STDERR_FILENO);
+  auto server = Server::listen(socket_path).value();
+  pid_t pid = fork();
+  if (pid == 0) {
+    std::ignore = server->run(app, 2);
+    _exit(0);
+  }
+
+  std::ignore = chdir("daemon_test_dir");
+  call({"cat", "note"}, string("../") + socket_path);
+  std::ignore = chdir("..");
+  call({"cat", "note"});
+  waitpid(pid, nullptr, 0);
+
+  unlink("daemon_test_dir/note");
+  rmdir("daemon_test_dir");
+}
+
+} // namespace
+} // namespace command
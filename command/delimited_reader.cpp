@@ -0,0 +1,66 @@
+#include "delimited_reader.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace command {
+namespace {
+
+constexpr size_t initial_buffer_size = 64 * 1024;
+
+} // namespace
+
+DelimitedReader::DelimitedReader(int fd, char delimiter)
+    : _fd(fd), _delimiter(delimiter), _buffer(initial_buffer_size)
+{}
+
+bee::OrError<std::optional<std::string_view>> DelimitedReader::next()
+{
+  size_t scanned = _begin;
+  while (true) {
+    auto* found = static_cast<const char*>(
+      std::memchr(_buffer.data() + scanned, _delimiter, _end - scanned));
+    if (found != nullptr) {
+      size_t item_end = found - _buffer.data();
+      std::string_view item(_buffer.data() + _begin, item_end - _begin);
+      _begin = item_end + 1;
+      return item;
+    }
+    scanned = _end;
+
+    if (_eof) {
+      if (_begin == _end) { return std::nullopt; }
+      std::string_view item(_buffer.data() + _begin, _end - _begin);
+      _begin = _end;
+      return item;
+    }
+
+    scanned -= _begin;
+    bail_unit(_fill());
+  }
+}
+
+bee::OrError<> DelimitedReader::_fill()
+{
+  if (_begin > 0) {
+    std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+    _end -= _begin;
+    _begin = 0;
+  }
+  if (_end == _buffer.size()) { _buffer.resize(_buffer.size() * 2); }
+
+  while (true) {
+    ssize_t n = read(_fd, _buffer.data() + _end, _buffer.size() - _end);
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return bee::Error::fmt("Failed to read input: $", strerror(errno));
+    }
+    if (n == 0) { _eof = true; }
+    _end += n;
+    return bee::ok();
+  }
+}
+
+} // namespace command
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Reads delimiter separated items from a file descriptor through a fixed size
+// buffer, so memory use doesn't depend on the size of the input. The buffer
+// only grows if a single item doesn't fit in it.
+struct DelimitedReader {
+ public:
+  explicit DelimitedReader(int fd, char delimiter);
+
+  DelimitedReader(const DelimitedReader&) = delete;
+  DelimitedReader& operator=(const DelimitedReader&) = delete;
+
+  // Returns the next item, or nullopt at the end of the input. The returned
+  // view is only valid until the next call.
+  bee::OrError<std::optional<std::string_view>> next();
+
+ private:
+  bee::OrError<> _fill();
+
+  int _fd;
+  char _delimiter;
+  bool _eof = false;
+  std::vector<char> _buffer;
+  size_t _begin = 0;
+  size_t _end = 0;
+};
+
+} // namespace command
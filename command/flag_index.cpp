@@ -0,0 +1,79 @@
+#include "flag_index.hpp"
+
+#include <algorithm>
+
+using std::string_view;
+
+namespace command {
+namespace {
+
+string_view flag_name(const Flag& flag)
+{
+  return visit([&](auto flag) -> string_view { return flag->name(); }, flag);
+}
+
+bool is_abbreviable(const string_view& name)
+{
+  return name.find_first_not_of('-') != string_view::npos;
+}
+
+} // namespace
+
+FlagIndex::FlagIndex(
+  const std::pmr::vector<Flag>& flags, MemoryResource* resource)
+    : _by_name(resource), _sorted(resource)
+{
+  _by_name.reserve(flags.size());
+  _sorted.reserve(flags.size());
+  for (const auto& flag : flags) {
+    auto name = flag_name(flag);
+    if (_by_name.emplace(name, flag).second) {
+      _sorted.push_back({.name = name, .flag = flag});
+    }
+  }
+  std::sort(_sorted.begin(), _sorted.end(), [](const auto& a, const auto& b) {
+    return a.name < b.name;
+  });
+}
+
+bee::OrError<FlagIndex::Match> FlagIndex::find(const string_view& arg) const
+{
+  auto eq = arg.find('=');
+  bail(flag, _find_name(arg.substr(0, eq)));
+  if (eq == string_view::npos) {
+    return Match{.flag = flag, .value = std::nullopt};
+  } else {
+    return Match{.flag = flag, .value = arg.substr(eq + 1)};
+  }
+}
+
+bee::OrError<Flag> FlagIndex::_find_name(const string_view& name) const
+{
+  if (auto it = _by_name.find(name); it != _by_name.end()) {
+    return it->second;
+  }
+  if (!is_abbreviable(name)) {
+    return bee::Error::fmt("Unknown flag '$'", name);
+  }
+
+  auto begin = std::lower_bound(
+    _sorted.begin(), _sorted.end(), name, [](const Entry& e, string_view n) {
+      return e.name < n;
+    });
+  auto end = begin;
+  while (end != _sorted.end() && end->name.starts_with(name)) { end++; }
+
+  if (begin == end) { return bee::Error::fmt("Unknown flag '$'", name); }
+  if (end - begin > 1) {
+    std::string candidates;
+    for (auto it = begin; it != end; it++) {
+      if (!candidates.empty()) { candidates += ", "; }
+      candidates += it->name;
+    }
+    return bee::Error::fmt(
+      "Ambiguous flag '$', could be one of: $", name, candidates);
+  }
+  return begin->flag;
+}
+
+} // namespace command
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.hpp"
+#include "command_flags.hpp"
+
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Lookup table for named flags, built once per command. Exact names are
+// resolved through a hash table, unambiguous prefixes (e.g. --verb for
+// --verbose) through a sorted array of the names. Arguments of the form
+// --flag=value are split before the lookup.
+struct FlagIndex {
+ public:
+  struct Match {
+    Flag flag;
+    std::optional<std::string_view> value;
+  };
+
+  explicit FlagIndex(
+    const std::pmr::vector<Flag>& flags,
+    MemoryResource* resource = default_resource());
+
+  bee::OrError<Match> find(const std::string_view& arg) const;
+
+ private:
+  bee::OrError<Flag> _find_name(const std::string_view& name) const;
+
+  struct Entry {
+    std::string_view name;
+    Flag flag;
+  };
+
+  std::pmr::unordered_map<std::string_view, Flag> _by_name;
+  std::pmr::vector<Entry> _sorted;
+};
+
+} // namespace command
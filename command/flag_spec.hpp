@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "bee/array_view.hpp"
 #include "bee/or_error.hpp"
 
 namespace command {
@@ -15,6 +18,23 @@ concept FlagSpec = requires(
   } -> std::convertible_to<bee::OrError<typename T::value_type>>;
 };
 
+// Specs that can parse many values in one call. of_string_many appends the
+// parsed values to out and stops at the first value that fails to parse, so
+// on error the failing value is values[out.size() - <size of out before>].
+template <class T>
+concept HasOfStringMany = FlagSpec<T> &&
+  requires(
+    const T& a,
+    const bee::ArrayView<const std::string_view>& values,
+    std::vector<typename T::value_type>& out) {
+    { a.of_string_many(values, out) } -> std::convertible_to<bee::OrError<>>;
+  };
+
+// Specs whose of_string returns the argument unchanged. Storage that can hold
+// the raw argument directly may skip calling of_string for them.
+template <class T>
+concept IdentityFlagSpec = FlagSpec<T> && T::is_identity;
+
 template <class T>
 concept HasOfString = requires(const std::string& str, const T& v) {
   { T::of_string(str) } -> std::convertible_to<bee::OrError<T>>;
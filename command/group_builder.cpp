@@ -1,8 +1,17 @@
 #include "group_builder.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
+#include "batch.hpp"
 #include "command_base.hpp"
+#include "command_flags.hpp"
+#include "daemon.hpp"
+#include "profile.hpp"
 
 #include "bee/print.hpp"
 #include "bee/string_util.hpp"
@@ -10,6 +19,50 @@
 namespace command {
 namespace {
 
+////////////////////////////////////////////////////////////////////////////////
+// LazyCommand
+//
+
+struct LazyCommand final : public CommandBase {
+ public:
+  LazyCommand(
+    const std::string_view& name,
+    const std::string_view& description,
+    GroupBuilder::factory_type&& factory,
+    MemoryResource* resource)
+      : CommandBase(description, resource),
+        _name(name, resource),
+        _factory(std::move(factory))
+  {}
+
+  virtual int execute(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view> args) const override
+  {
+    return _get().execute(log_output, args);
+  }
+
+  // Building the command to learn its flags would defeat the point, plugins
+  // would all be loaded, so only the name the group lists is completed
+  virtual void describe(CompletionTree&) const override {}
+
+ private:
+  const Cmd& _get() const
+  {
+    std::call_once(_built, [this] {
+      Profiler::Span span("build", _name);
+      _cmd.emplace(_factory());
+    });
+    return *_cmd;
+  }
+
+  const std::pmr::string _name;
+  const GroupBuilder::factory_type _factory;
+
+  mutable std::once_flag _built;
+  mutable std::optional<Cmd> _cmd;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // CommandGroup
 //
@@ -17,12 +70,12 @@ namespace {
 struct CommandGroup final : public CommandBase {
  private:
   struct HelpPrinter final : public CommandBase {
-    HelpPrinter(CommandGroup& parent)
-        : CommandBase("Prints this help"), _parent(parent)
+    HelpPrinter(CommandGroup& parent, MemoryResource* resource)
+        : CommandBase("Prints this help", resource), _parent(parent)
     {}
     virtual int execute(
       const bee::LogOutput log_output,
-      const bee::ArrayView<const std::string>) const override
+      const bee::ArrayView<const std::string_view>) const override
     {
       _parent.print_help(log_output);
       return 0;
@@ -33,15 +86,55 @@ struct CommandGroup final : public CommandBase {
   };
 
  public:
+  using handler_map = std::pmr::map<std::pmr::string, Cmd, std::less<>>;
+
   CommandGroup(
-    const std::string_view& description, std::map<std::string, Cmd>&& handlers)
-      : CommandBase(description), _handlers(std::move(handlers))
+    const std::string_view& description,
+    handler_map&& handlers,
+    const std::optional<std::pmr::string>& serve_name,
+    const std::optional<std::pmr::string>& batch_name,
+    const std::optional<std::pmr::string>& profile_name,
+    const std::pmr::vector<std::pmr::string>& completion_inputs,
+    MemoryResource* resource)
+      : CommandBase(description, resource),
+        _handlers(std::move(handlers)),
+        _profile_name(profile_name),
+        _completion_inputs(completion_inputs, resource),
+        _index(resource)
   {
-    _add_cmd("help", Cmd(std::make_shared<HelpPrinter>(*this)));
+    _add_cmd(
+      "help",
+      Cmd(make_shared_in<HelpPrinter>(resource, [&](void* mem) {
+        return new (mem) HelpPrinter(*this, resource);
+      })));
+    // The serve and batch commands are owned by the group, so they only keep a
+    // non-owning reference back to it
+    auto self = Cmd(std::shared_ptr<CommandBase>(
+      std::shared_ptr<CommandBase>(), static_cast<CommandBase*>(this)));
+    if (serve_name.has_value()) {
+      _add_cmd(*serve_name, serve_command(self, resource));
+    }
+    if (batch_name.has_value()) {
+      _add_cmd(*batch_name, batch_command(self, resource));
+    }
   }
 
   virtual ~CommandGroup() {}
 
+  virtual void describe(CompletionTree& tree) const override
+  {
+    for (const auto& [name, cmd] : _handlers) {
+      auto& subcommand = tree.subcommands.emplace_back(std::string(name));
+      cmd.base()->describe(subcommand.tree);
+    }
+    if (_profile_name.has_value()) {
+      tree.flags.emplace_back(std::string(*_profile_name), "file");
+    }
+    for (const auto& input : _completion_inputs) {
+      tree.inputs.emplace_back(input);
+    }
+  }
+
   void print_help(const bee::LogOutput log_output) const
   {
     PF(log_output, "Available comands:");
@@ -55,39 +148,194 @@ struct CommandGroup final : public CommandBase {
       PF(
         log_output,
         "  $  $",
-        bee::right_pad_string(cmd.first, longest_name),
+        bee::right_pad_string(std::string(cmd.first), longest_name),
         cmd.second.description());
     }
+    if (_profile_name.has_value()) {
+      PF(log_output, "");
+      print_flag_docs(
+        log_output,
+        {make_value_flag_doc(
+          *_profile_name, "file", profile_doc, false, std::nullopt)});
+    }
   }
 
   virtual int execute(
     const bee::LogOutput log_output,
-    const bee::ArrayView<const std::string> args) const override
+    const bee::ArrayView<const std::string_view> args) const override
+  {
+    if (_profile_name.has_value() && !args.empty()) {
+      const std::string_view name = *_profile_name;
+      const auto& arg = args.front();
+      std::optional<std::string> path;
+      size_t consumed = 1;
+      if (arg == name) {
+        if (args.size() < 2) {
+          record_error(bee::Error::fmt("No arguments for flag $", name));
+          PF(log_output, "ERROR: No arguments for flag $\n", name);
+          print_help(log_output);
+          return 1;
+        }
+        path.emplace(args[1]);
+        consumed = 2;
+      } else if (
+        arg.starts_with(name) && arg.size() > name.size() &&
+        arg[name.size()] == '=') {
+        path.emplace(arg.substr(name.size() + 1));
+      }
+      if (path.has_value() && Profiler::current() == nullptr) {
+        return run_profiled(*path, log_output, [&] {
+          return _dispatch(log_output, args.slice(consumed));
+        });
+      } else if (path.has_value()) {
+        return _dispatch(log_output, args.slice(consumed));
+      }
+    }
+    return _dispatch(log_output, args);
+  }
+
+ private:
+  // A node of the dispatch index, which flattens this group and all the
+  // groups nested in it into a trie over the command names. The children of a
+  // node are contiguous and sorted by name.
+  struct Node {
+   public:
+    std::string_view name;
+    uint32_t first_child = 0;
+    uint32_t num_children = 0;
+    const CommandBase* command;
+    // Set if the command is a group, whose subcommands are the children
+    const CommandGroup* group;
+  };
+
+  // Children whose name starts with a token, they are contiguous in the index
+  struct Match {
+   public:
+    uint32_t first = 0;
+    uint32_t count = 0;
+  };
+
+  static constexpr std::string_view profile_doc =
+    "Writes a timed trace of this invocation to file";
+
+  int _dispatch(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view> args) const
+  {
+    // Nested groups are walked through the index in a single pass over the
+    // arguments, without going through each group's execute, unless they
+    // take flags
+    uint32_t node = 0;
+    size_t depth = 0;
+    Match match;
+    {
+      Profiler::Span span("dispatch");
+      std::call_once(_index_built, [this] {
+        Profiler::Span span("build index");
+        _build_index();
+      });
+      while (depth < args.size() && _index[node].group != nullptr) {
+        match = _find_child(_index[node], args[depth]);
+        if (match.count != 1) { break; }
+        node = match.first;
+        depth++;
+      }
+    }
+
+    const auto& found = _index[node];
+    const auto rest = args.slice(depth);
+    if (found.group == nullptr) {
+      return found.command->execute(log_output, rest);
+    }
+    return found.group->_fail(
+      log_output,
+      rest,
+      bee::ArrayView<const Node>(_index.data() + match.first, match.count));
+  }
+
+  void _add_cmd(const std::string_view& name, const Cmd& command)
+  {
+    _handlers.emplace(name, command);
+  }
+
+  // Built on the first call to execute rather than at construction, so groups
+  // that are only reached through their parent's index never build their own
+  void _build_index() const
+  {
+    _index.push_back(Node{.name = "", .command = this, .group = this});
+    for (size_t i = 0; i < _index.size(); i++) {
+      const CommandGroup* group = _index[i].group;
+      if (group == nullptr) { continue; }
+      _index[i].first_child = _index.size();
+      _index[i].num_children = group->_handlers.size();
+      for (const auto& [name, cmd] : group->_handlers) {
+        // Groups that take flags of their own are dispatched to through their
+        // execute, which handles them
+        auto nested = dynamic_cast<const CommandGroup*>(cmd.base());
+        if (nested != nullptr && nested->_profile_name.has_value()) {
+          nested = nullptr;
+        }
+        _index.push_back(Node{
+          .name = name,
+          .command = cmd.base(),
+          .group = nested,
+        });
+      }
+    }
+  }
+
+  // An exact match wins, otherwise the token may be a prefix of the name
+  Match _find_child(const Node& parent, const std::string_view& token) const
+  {
+    const auto begin = _index.begin() + parent.first_child;
+    const auto end = begin + parent.num_children;
+    auto it = std::lower_bound(
+      begin, end, token, [](const Node& node, const std::string_view& token) {
+        return node.name < token;
+      });
+    const uint32_t first = it - _index.begin();
+    if (it != end && it->name == token) { return {first, 1}; }
+    if (token.empty()) { return {}; }
+    auto last = it;
+    while (last != end && last->name.starts_with(token)) { ++last; }
+    return {first, uint32_t(last - it)};
+  }
+
+  int _fail(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view> args,
+    const bee::ArrayView<const Node> candidates) const
   {
     if (args.empty()) {
+      record_error(bee::Error("No arguments given"));
       PF(log_output, "ERROR: No arguments given\n");
       print_help(log_output);
       return 1;
     }
 
-    const std::string& cmd = args.front();
-    auto it = _handlers.find(cmd);
-    if (it == _handlers.end()) {
-      PF(log_output, "Unknown command: $", cmd);
-      print_help(log_output);
-      return 1;
+    const std::string_view& cmd = args.front();
+    if (candidates.size() > 1) {
+      std::string names;
+      for (const auto& candidate : candidates) {
+        if (!names.empty()) { names += ", "; }
+        names += candidate.name;
+      }
+      record_error(bee::Error::fmt("Ambiguous command: $", cmd));
+      PF(log_output, "Ambiguous command: $, could be $", cmd, names);
     } else {
-      return it->second.execute(log_output, args.slice(1));
+      record_error(bee::Error::fmt("Unknown command: $", cmd));
+      PF(log_output, "Unknown command: $", cmd);
     }
+    print_help(log_output);
+    return 1;
   }
 
- private:
-  void _add_cmd(const std::string_view& name, const Cmd& command)
-  {
-    _handlers.emplace(name, command);
-  }
+  handler_map _handlers;
+  std::optional<std::pmr::string> _profile_name;
+  std::pmr::vector<std::pmr::string> _completion_inputs;
 
-  std::map<std::string, Cmd> _handlers;
+  mutable std::once_flag _index_built;
+  mutable std::pmr::vector<Node> _index;
 };
 
 } // namespace
@@ -96,9 +344,15 @@ struct CommandGroup final : public CommandBase {
 // GroupBuilder
 //
 
-GroupBuilder::GroupBuilder(const std::string_view& description)
-    : _description(description)
-{}
+GroupBuilder::GroupBuilder(
+  const std::string_view& description, MemoryResource* resource)
+    : _resource(resource),
+      _handlers(resource),
+      _completion_inputs(resource),
+      _description(description, resource)
+{
+  Profiler::note_construction();
+}
 
 GroupBuilder& GroupBuilder::cmd(
   const std::string_view& name, const Cmd& command)
@@ -107,9 +361,55 @@ GroupBuilder& GroupBuilder::cmd(
   return *this;
 }
 
+GroupBuilder& GroupBuilder::lazy_cmd(
+  const std::string_view& name,
+  const std::string_view& description,
+  factory_type factory)
+{
+  _handlers.emplace(
+    name, Cmd(make_shared_in<LazyCommand>(_resource, [&](void* mem) {
+      return new (mem)
+        LazyCommand(name, description, std::move(factory), _resource);
+    })));
+  return *this;
+}
+
+GroupBuilder& GroupBuilder::serve(const std::string_view& name)
+{
+  _serve_name.emplace(name, _resource);
+  return *this;
+}
+
+GroupBuilder& GroupBuilder::batch(const std::string_view& name)
+{
+  _batch_name.emplace(name, _resource);
+  return *this;
+}
+
+GroupBuilder& GroupBuilder::profile(const std::string_view& name)
+{
+  _profile_name.emplace(name, _resource);
+  return *this;
+}
+
+GroupBuilder& GroupBuilder::completion_input(const std::string_view& path)
+{
+  _completion_inputs.emplace_back(path);
+  return *this;
+}
+
 Cmd GroupBuilder::build()
 {
-  return Cmd(make_shared<CommandGroup>(_description, std::move(_handlers)));
+  return Cmd(make_shared_in<CommandGroup>(_resource, [&](void* mem) {
+    return new (mem) CommandGroup(
+      _description,
+      std::move(_handlers),
+      _serve_name,
+      _batch_name,
+      _profile_name,
+      _completion_inputs,
+      _resource);
+  }));
 }
 
 } // namespace command
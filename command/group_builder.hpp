@@ -1,26 +1,68 @@
 #pragma once
 
+#include <functional>
 #include <map>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <vector>
 
+#include "arena.hpp"
 #include "cmd.hpp"
 
 namespace command {
 
 struct GroupBuilder {
  public:
-  GroupBuilder(const std::string_view& description);
+  // The group and its subcommand table are allocated from resource, which must
+  // outlive the Cmd returned by build, see arena.hpp.
+  GroupBuilder(
+    const std::string_view& description,
+    MemoryResource* resource = default_resource());
 
   GroupBuilder& cmd(const std::string_view& name, const Cmd& command);
 
+  // Adds a subcommand that is only built, by calling factory, the first time
+  // it's dispatched to. The help listing uses description and builds nothing,
+  // and so does shell completion, which only completes its name.
+  using factory_type = std::function<Cmd()>;
+  GroupBuilder& lazy_cmd(
+    const std::string_view& name,
+    const std::string_view& description,
+    factory_type factory);
+
+  // Adds a subcommand that serves the whole group over a Unix socket, see
+  // daemon.hpp.
+  GroupBuilder& serve(const std::string_view& name = "serve");
+
+  // Adds a subcommand that runs commands of the group for each line of a
+  // file, see batch.hpp.
+  GroupBuilder& batch(const std::string_view& name = "batch");
+
+  // Accepts a flag before the subcommand that writes a trace of the
+  // invocation to a file, from dispatch to the handler returning, see
+  // profile.hpp.
+  GroupBuilder& profile(const std::string_view& name = "--profile");
+
+  // Records a file the group was built from, e.g. a plugin manifest, so the
+  // cached completion index is refreshed when it changes, see completion.hpp.
+  GroupBuilder& completion_input(const std::string_view& path);
+
   Cmd build();
 
   const std::string& description() const;
 
  private:
-  std::map<std::string, Cmd> _handlers;
+  using handler_map = std::pmr::map<std::pmr::string, Cmd, std::less<>>;
+
+  MemoryResource* _resource;
+  handler_map _handlers;
+  std::optional<std::pmr::string> _serve_name;
+  std::optional<std::pmr::string> _batch_name;
+  std::optional<std::pmr::string> _profile_name;
+  std::pmr::vector<std::pmr::string> _completion_inputs;
 
-  std::string _description;
+  std::pmr::string _description;
 };
 
 } // namespace command
@@ -1,3 +1,9 @@
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+#include <unistd.h>
+
 #include "command_builder.hpp"
 #include "group_builder.hpp"
 
@@ -55,5 +61,152 @@ TEST(basic)
   run_test({"binary", "help"});
 }
 
+TEST(arena)
+{
+  // The arena can't grow, so building or running the tree fails if anything
+  // in it is allocated past the buffer.
+  static std::array<std::byte, 64 * 1024> buffer;
+  std::pmr::monotonic_buffer_resource arena(
+    buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+  auto builder = CommandBuilder("Sub command", &arena);
+  auto name = builder.required("--name", flags::String);
+  auto count = builder.optional_with_default("--count", flags::Int, 1);
+  auto files = builder.repeated_anon(flags::String, "files");
+  auto cmd = builder.run([=]() {
+    P("name:$ count:$ files:$", *name, *count, *files);
+    return bee::ok();
+  });
+  auto grp = GroupBuilder("group", &arena)
+               .cmd("subcommand", cmd)
+               .cmd("other", CommandBuilder("Other", &arena).run(example_app))
+               .build();
+
+  P("--------------------------------------------");
+  P("test 1");
+  run_cmd({"binary", "subcommand", "--name=foo", "a", "b"}, grp);
+
+  P("--------------------------------------------");
+  P("test 2");
+  run_cmd({"binary", "other"}, grp);
+
+  P("--------------------------------------------");
+  P("test 3");
+  run_cmd({"binary", "subcommand", "--help"}, grp);
+
+  P("--------------------------------------------");
+  P("test 4");
+  run_cmd({"binary", "help"}, grp);
+}
+
+TEST(lazy_cmd)
+{
+  auto make_factory = [](const string& name) {
+    return [=]() {
+      P("Building $", name);
+      return CommandBuilder("Built " + name).run(example_app);
+    };
+  };
+  auto grp = GroupBuilder("group")
+               .lazy_cmd("first", "First command", make_factory("first"))
+               .lazy_cmd("second", "Second command", make_factory("second"))
+               .build();
+
+  P("--------------------------------------------");
+  P("test 1");
+  run_cmd({"binary", "help"}, grp);
+
+  P("--------------------------------------------");
+  P("test 2");
+  run_cmd({"binary", "first"}, grp);
+
+  P("--------------------------------------------");
+  P("test 3");
+  run_cmd({"binary", "first"}, grp);
+
+  P("--------------------------------------------");
+  P("test 4");
+  run_cmd({"binary", "second", "--help"}, grp);
+}
+
+TEST(nested)
+{
+  auto leaf = [](const string& name) {
+    return CommandBuilder("Runs " + name).run([=]() {
+      P("Running $", name);
+      return bee::ok();
+    });
+  };
+  auto remote = GroupBuilder("Remote commands")
+                  .cmd("add", leaf("remote add"))
+                  .cmd("remove", leaf("remote remove"))
+                  .cmd("rename", leaf("remote rename"))
+                  .build();
+  auto config = GroupBuilder("Configuration")
+                  .cmd("remote", remote)
+                  .cmd("reset", leaf("config reset"))
+                  .build();
+  auto grp = GroupBuilder("group")
+               .cmd("config", config)
+               .cmd("commit", leaf("commit"))
+               .build();
+
+  P("--------------------------------------------");
+  P("test 1");
+  run_cmd({"binary", "config", "remote", "add"}, grp);
+
+  P("--------------------------------------------");
+  P("test 2");
+  run_cmd({"binary", "conf", "rem", "ren"}, grp);
+
+  P("--------------------------------------------");
+  P("test 3");
+  run_cmd({"binary", "co"}, grp);
+
+  P("--------------------------------------------");
+  P("test 4");
+  run_cmd({"binary", "config", "remote", "re"}, grp);
+
+  P("--------------------------------------------");
+  P("test 5");
+  run_cmd({"binary", "config", "remote"}, grp);
+
+  P("--------------------------------------------");
+  P("test 6");
+  run_cmd({"binary", "config", "nope", "add"}, grp);
+
+  P("--------------------------------------------");
+  P("test 7");
+  run_cmd({"binary", "config", "remote", "help"}, grp);
+
+  P("--------------------------------------------");
+  P("test 8");
+  run_cmd({"binary", "commit", "--help"}, grp);
+
+  P("--------------------------------------------");
+  P("test 9");
+  run_cmd({"binary", "config", "remote", "add", "extra"}, grp);
+}
+
+TEST(nested_with_flags)
+{
+  // A nested group that takes flags is dispatched to through its execute
+  auto sub = GroupBuilder("Sub")
+               .profile()
+               .cmd("cmd", CommandBuilder("Sub command").run(example_app))
+               .build();
+  auto grp = GroupBuilder("group").cmd("sub", sub).build();
+
+  auto path = "/tmp/group_builder_test_" + std::to_string(getpid());
+  run_cmd({"binary", "sub", "--profile", path, "cmd"}, grp);
+  P("trace written: $", unlink(path.c_str()) == 0);
+
+  P("--------------------------------------------");
+  run_cmd({"binary", "sub", "cmd"}, grp);
+
+  P("--------------------------------------------");
+  run_cmd({"binary", "sub", "nope"}, grp);
+}
+
 } // namespace
 } // namespace command
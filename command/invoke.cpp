@@ -0,0 +1,108 @@
+#include "invoke.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "command_base.hpp"
+#include "io_util.hpp"
+
+
+namespace command {
+namespace {
+
+std::mutex capture_mutex;
+
+// Points fd at an in-memory file until the redirect is destroyed.
+struct Redirect {
+ public:
+  static bee::OrError<std::unique_ptr<Redirect>> create(
+    int fd, const char* name)
+  {
+    int file = memfd_create(name, MFD_CLOEXEC);
+    if (file == -1) {
+      return bee::Error::fmt("Failed to create $: $", name, strerror(errno));
+    }
+    int saved = dup(fd);
+    if (saved == -1 || dup2(file, fd) == -1) {
+      int err = errno;
+      if (saved != -1) { close(saved); }
+      close(file);
+      return bee::Error::fmt("Failed to redirect $: $", name, strerror(err));
+    }
+    return std::unique_ptr<Redirect>(new Redirect(fd, file, saved));
+  }
+
+  ~Redirect()
+  {
+    dup2(_saved, _fd);
+    close(_saved);
+    close(_file);
+  }
+
+  Redirect(const Redirect&) = delete;
+  Redirect& operator=(const Redirect&) = delete;
+
+  bee::OrError<std::string> read_all() const
+  {
+    std::string out;
+    char buffer[1 << 16];
+    for (off_t offset = 0;;) {
+      ssize_t n = pread(_file, buffer, sizeof(buffer), offset);
+      if (n == -1) {
+        if (errno == EINTR) { continue; }
+        return bee::Error::fmt("Failed to read output: $", strerror(errno));
+      }
+      if (n == 0) { return out; }
+      out.append(buffer, n);
+      offset += n;
+    }
+  }
+
+ private:
+  Redirect(int fd, int file, int saved) : _fd(fd), _file(file), _saved(saved)
+  {}
+
+  const int _fd;
+  const int _file;
+  const int _saved;
+};
+
+} // namespace
+
+bee::OrError<InvokeResult> invoke(
+  const Cmd& cmd,
+  const bee::ArrayView<const std::string_view> args,
+  const bee::LogOutput log_output)
+{
+  std::lock_guard lock(capture_mutex);
+
+  io_util::flush_output();
+  bail(out, Redirect::create(STDOUT_FILENO, "command-stdout"));
+  bail(err, Redirect::create(STDERR_FILENO, "command-stderr"));
+
+  CommandBase::ErrorCapture capture;
+  int exit_code;
+  try {
+    exit_code = cmd.execute(log_output, args);
+  } catch (...) {
+    io_util::flush_output();
+    throw;
+  }
+  io_util::flush_output();
+
+  bail(out_str, out->read_all());
+  bail(err_str, err->read_all());
+  return InvokeResult{
+    .exit_code = exit_code,
+    .error = capture.error(),
+    .out = std::move(out_str),
+    .err = std::move(err_str),
+  };
+}
+
+} // namespace command
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "cmd.hpp"
+
+#include "bee/array_view.hpp"
+#include "bee/log_output.hpp"
+#include "bee/or_error.hpp"
+
+namespace command {
+
+struct InvokeResult {
+ public:
+  int exit_code;
+
+  // The error that made the command fail, if it reported one.
+  std::optional<bee::Error> error;
+
+  // Everything written to stdout and stderr while the command ran.
+  std::string out;
+  std::string err;
+};
+
+// Runs cmd in this process as if it was executed with args, capturing its
+// output. Handlers print straight to the standard file descriptors, so they
+// are redirected to in-memory files for the duration of the call, which also
+// captures output from other threads. Captured invocations are serialized
+// process wide.
+//
+// Fails only if the output can't be captured, a command failure is reported
+// through the result.
+bee::OrError<InvokeResult> invoke(
+  const Cmd& cmd,
+  bee::ArrayView<const std::string_view> args,
+  bee::LogOutput log_output = bee::LogOutput::StdErr);
+
+} // namespace command
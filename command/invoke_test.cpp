@@ -0,0 +1,57 @@
+#include <string>
+#include <vector>
+
+#include "command_builder.hpp"
+#include "group_builder.hpp"
+#include "invoke.hpp"
+
+#include "bee/format_optional.hpp"
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace command {
+namespace {
+
+Cmd make_app()
+{
+  auto builder = CommandBuilder("Greets");
+  auto name = builder.required("--name", flags::String);
+  auto fail = builder.no_arg("--fail");
+  auto greet = builder.run([=]() -> bee::OrError<> {
+    P("Hello $", *name);
+    PF(bee::LogOutput::StdErr, "Greeted $", *name);
+    if (*fail) { return bee::Error::fmt("Failed to greet $", *name); }
+    return bee::ok();
+  });
+  return GroupBuilder("App").cmd("greet", greet).build();
+}
+
+void run_test(const Cmd& cmd, const vector<string_view>& args)
+{
+  P("args: '$'", vector<string>(args.begin(), args.end()));
+  auto result =
+    invoke(cmd, bee::ArrayView<const string_view>(args)).value();
+  P("exit_code: $", result.exit_code);
+  P("error: $", result.error);
+  P("out: '$'", result.out);
+  P("err: '$'", result.err);
+  P("------------------------------------");
+}
+
+TEST(invoke)
+{
+  auto app = make_app();
+  run_test(app, {"greet", "--name", "world"});
+  run_test(app, {"greet", "--name", "world", "--fail"});
+  run_test(app, {"greet"});
+  run_test(app, {"wave"});
+  P("Output is no longer captured");
+}
+
+} // namespace
+} // namespace command
@@ -0,0 +1,45 @@
+#include "io_util.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bee/file_writer.hpp"
+
+namespace command::io_util {
+
+bee::OrError<std::string> read_file(const std::string& path)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return bee::Error::fmt("Failed to open '$': $", path, strerror(errno));
+  }
+  std::string content;
+  char buffer[1 << 16];
+  while (true) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n == -1) {
+      if (errno == EINTR) { continue; }
+      int err = errno;
+      close(fd);
+      return bee::Error::fmt("Failed to read '$': $", path, strerror(err));
+    }
+    if (n == 0) { break; }
+    content.append(buffer, n);
+  }
+  close(fd);
+  return content;
+}
+
+void flush_output()
+{
+  std::ignore = bee::FileWriter::stdout().flush();
+  std::fflush(stdout);
+  std::fflush(stderr);
+}
+
+} // namespace command::io_util
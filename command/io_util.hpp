@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "bee/or_error.hpp"
+
+namespace command::io_util {
+
+// Reads the whole file at path.
+bee::OrError<std::string> read_file(const std::string& path);
+
+// Writes out what bee's stdout writer and stdio have buffered, before the
+// standard file descriptors are pointed elsewhere or inherited by a fork.
+void flush_output();
+
+} // namespace command::io_util
@@ -0,0 +1,50 @@
+#include "parse_state.hpp"
+
+#include <stdexcept>
+
+namespace command {
+namespace {
+
+thread_local ParseState* current_state = nullptr;
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// ParseState
+//
+
+ParseState::ParseState(size_t num_slots, MemoryResource* resource, bool lazy)
+    : _resource(resource),
+      _num_slots(num_slots),
+      _slots(static_cast<Slot*>(
+        resource->allocate(sizeof(Slot) * num_slots, alignof(Slot)))),
+      _lazy(lazy)
+{
+  for (size_t i = 0; i < num_slots; i++) { new (&_slots[i]) Slot(); }
+}
+
+ParseState::~ParseState()
+{
+  for (size_t i = 0; i < _num_slots; i++) {
+    auto& slot = _slots[i];
+    if (slot.ptr != nullptr) { slot.destroy(slot.ptr, _resource); }
+  }
+  _resource->deallocate(_slots, sizeof(Slot) * _num_slots, alignof(Slot));
+}
+
+ParseState& ParseState::current()
+{
+  if (current_state == nullptr) {
+    throw std::logic_error("Flag accessed outside of a command invocation");
+  }
+  return *current_state;
+}
+
+ParseState::Scope::Scope(ParseState& state) : _previous(current_state)
+{
+  current_state = &state;
+}
+
+ParseState::Scope::~Scope() { current_state = _previous; }
+
+} // namespace command
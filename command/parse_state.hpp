@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+#include "arena.hpp"
+
+namespace command {
+
+// Values parsed by one invocation of a command. Flags are immutable
+// definitions that own a slot index, and keep what they parse in the slot of
+// the ParseState of the invocation, so the same Cmd can be executed
+// repeatedly and from several threads at once.
+//
+// The command makes its state current on the calling thread while it parses
+// and runs the handler, which is how flag accessors find it. Flags must be
+// read from that thread, while the handler runs.
+struct ParseState {
+ public:
+  ParseState(size_t num_slots, MemoryResource* resource, bool lazy = false);
+  ~ParseState();
+
+  ParseState(const ParseState&) = delete;
+  ParseState& operator=(const ParseState&) = delete;
+
+  // Returns the object in the slot, constructing it with args on first use. A
+  // slot must always be accessed with the same type.
+  template <class T, class... Args> T& get(size_t slot, Args&&... args)
+  {
+    auto& entry = _slots[slot];
+    if (entry.ptr == nullptr) {
+      void* mem = _resource->allocate(sizeof(T), alignof(T));
+      entry.ptr = new (mem) T(std::forward<Args>(args)...);
+      entry.destroy = [](void* ptr, MemoryResource* resource) {
+        static_cast<T*>(ptr)->~T();
+        resource->deallocate(ptr, sizeof(T), alignof(T));
+      };
+    }
+    return *static_cast<T*>(entry.ptr);
+  }
+
+  // Whether value flags only record their argument while parsing, and parse it
+  // the first time it's accessed, see LazyParsing.
+  bool is_lazy() const { return _lazy; }
+
+  // The state of the invocation running on this thread. Throws if there is
+  // none, which means a flag was read outside of its command's handler.
+  static ParseState& current();
+
+  // Makes a state current on this thread for the lifetime of the scope.
+  struct Scope {
+   public:
+    explicit Scope(ParseState& state);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    ParseState* _previous;
+  };
+
+ private:
+  struct Slot {
+    void* ptr = nullptr;
+    void (*destroy)(void*, MemoryResource*) = nullptr;
+  };
+
+  MemoryResource* _resource;
+  size_t _num_slots;
+  Slot* _slots;
+  const bool _lazy;
+};
+
+// Base of flag definitions, holds the slot the flag keeps its state in.
+struct Stateful {
+ public:
+  size_t slot() const { return _slot; }
+  void set_slot(size_t slot) { _slot = slot; }
+
+ protected:
+  template <class T, class... Args> T& state(Args&&... args) const
+  {
+    return ParseState::current().get<T>(_slot, std::forward<Args>(args)...);
+  }
+
+ private:
+  size_t _slot = 0;
+};
+
+} // namespace command
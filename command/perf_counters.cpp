@@ -0,0 +1,240 @@
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bee/print.hpp"
+
+namespace command {
+namespace {
+
+thread_local PerfCounters* current_counters = nullptr;
+
+constexpr std::array<uint64_t, PerfCounters::num_counters> hardware_events = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES,
+  PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int open_counter(uint64_t event)
+{
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = event;
+  attr.read_format =
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // Leaving the kernel out keeps the counters available with the default
+  // perf_event_paranoid setting
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+std::string left_pad(const std::string& str, size_t width)
+{
+  return std::string(width - std::min(width, str.size()), ' ') + str;
+}
+
+std::string right_pad(const std::string& str, size_t width)
+{
+  return str + std::string(width - std::min(width, str.size()), ' ');
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// PerfCounters
+//
+
+std::string_view PerfCounters::counter_name(const Counter counter)
+{
+  switch (counter) {
+  case Cycles:
+    return "cycles";
+  case Instructions:
+    return "instructions";
+  case CacheMisses:
+    return "cache-misses";
+  case BranchMisses:
+    return "branch-misses";
+  }
+  return "unknown";
+}
+
+PerfCounters::PerfCounters()
+{
+  for (size_t i = 0; i < num_counters; i++) {
+    _fds[i] = open_counter(hardware_events[i]);
+    if (_fds[i] == -1 && !_unavailable_reason.has_value()) {
+      _unavailable_reason = F(
+        "$ unavailable: $", counter_name(Counter(i)), strerror(errno));
+    }
+  }
+}
+
+PerfCounters::~PerfCounters()
+{
+  for (int fd : _fds) {
+    if (fd != -1) { close(fd); }
+  }
+}
+
+bool PerfCounters::is_available(const Counter counter) const
+{
+  return _fds[counter] != -1;
+}
+
+PerfCounters* PerfCounters::current() { return current_counters; }
+
+PerfCounters::Scope::Scope(PerfCounters& counters)
+    : _previous(current_counters)
+{
+  current_counters = &counters;
+}
+
+PerfCounters::Scope::~Scope() { current_counters = _previous; }
+
+PerfCounters::Region::Region(const std::string_view& name)
+    : _counters(current_counters)
+{
+  if (_counters == nullptr) { return; }
+  _row = _counters->_row(name);
+  _start = _counters->_read();
+}
+
+PerfCounters::Region::~Region()
+{
+  if (_counters == nullptr) { return; }
+  auto end = _counters->_read();
+  auto& row = _counters->_rows[_row];
+  row.calls++;
+  for (size_t i = 0; i < num_counters; i++) {
+    row.values[i] += end[i] - std::min(end[i], _start[i]);
+  }
+}
+
+std::array<uint64_t, PerfCounters::num_counters> PerfCounters::_read() const
+{
+  std::array<uint64_t, num_counters> values = {};
+  for (size_t i = 0; i < num_counters; i++) {
+    if (_fds[i] == -1) { continue; }
+    // The value, then the time the counter was enabled and running
+    uint64_t data[3];
+    if (read(_fds[i], data, sizeof(data)) != sizeof(data)) { continue; }
+    values[i] = data[2] == 0 || data[2] == data[1]
+                  ? data[0]
+                  : uint64_t(double(data[0]) * data[1] / data[2]);
+  }
+  return values;
+}
+
+size_t PerfCounters::_row(const std::string_view& name)
+{
+  for (size_t i = 0; i < _rows.size(); i++) {
+    if (_rows[i].name == name) { return i; }
+  }
+  _rows.push_back({.name = std::string(name)});
+  return _rows.size() - 1;
+}
+
+std::vector<std::string> PerfCounters::format_summary() const
+{
+  std::vector<std::string> header;
+  header.push_back("region");
+  header.push_back("calls");
+  for (size_t i = 0; i < num_counters; i++) {
+    if (!is_available(Counter(i))) { continue; }
+    header.emplace_back(counter_name(Counter(i)));
+    if (i == Instructions && is_available(Cycles)) { header.push_back("IPC"); }
+  }
+  std::vector<std::vector<std::string>> cells = {header};
+  for (const auto& row : _rows) {
+    auto& line = cells.emplace_back();
+    line.push_back(row.name);
+    line.push_back(std::to_string(row.calls));
+    for (size_t i = 0; i < num_counters; i++) {
+      if (!is_available(Counter(i))) { continue; }
+      line.push_back(std::to_string(row.values[i]));
+      if (i == Instructions && is_available(Cycles)) {
+        char ipc[32];
+        snprintf(
+          ipc,
+          sizeof(ipc),
+          "%.2f",
+          row.values[Cycles] == 0
+            ? 0.0
+            : double(row.values[Instructions]) / row.values[Cycles]);
+        line.push_back(ipc);
+      }
+    }
+  }
+
+  std::vector<size_t> widths(header.size(), 0);
+  for (const auto& line : cells) {
+    for (size_t i = 0; i < line.size(); i++) {
+      widths[i] = std::max(widths[i], line[i].size());
+    }
+  }
+  std::vector<std::string> out;
+  for (const auto& line : cells) {
+    std::string formatted = right_pad(line[0], widths[0]);
+    for (size_t i = 1; i < line.size(); i++) {
+      formatted += "  " + left_pad(line[i], widths[i]);
+    }
+    out.push_back(std::move(formatted));
+  }
+  if (_unavailable_reason.has_value()) {
+    out.push_back("Not all counters were measured, " + *_unavailable_reason);
+  }
+  return out;
+}
+
+int run_with_perf_counters(
+  const std::string& destination,
+  const bee::LogOutput log_output,
+  const std::function<int()>& fn)
+{
+  PerfCounters counters;
+  int exit_code;
+  {
+    PerfCounters::Scope scope(counters);
+    PerfCounters::Region region("handler");
+    exit_code = fn();
+  }
+
+  auto summary = counters.format_summary();
+  if (destination == "-") {
+    for (const auto& line : summary) { PF(log_output, "$", line); }
+    return exit_code;
+  }
+
+  std::string content;
+  for (const auto& line : summary) {
+    content += line;
+    content += '\n';
+  }
+  FILE* file = fopen(destination.c_str(), "we");
+  bool ok = file != nullptr &&
+            fwrite(content.data(), 1, content.size(), file) == content.size();
+  if (file != nullptr) { ok = fclose(file) == 0 && ok; }
+  if (!ok) {
+    PF(
+      log_output,
+      "ERROR: Failed to write performance counters to $: $",
+      destination,
+      strerror(errno));
+    return exit_code == 0 ? 1 : exit_code;
+  }
+  return exit_code;
+}
+
+} // namespace command
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bee/log_output.hpp"
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Hardware performance counters for the --perf-counters flag, see
+// CommandBuilder::perf_counters. While a PerfCounters is current on a thread,
+// each Region adds what the counters measured between its construction and
+// destruction to a row of the same name. The handler is measured as the
+// "handler" region, and handlers can open their own regions:
+//
+//   PerfCounters::Region region("decode");
+//
+// Regions do nothing unless the flag was given. Only the thread that opened
+// the counters is measured, work the handler hands to other threads isn't.
+//
+// Counters the kernel doesn't provide, in containers and many VMs, are left
+// out of the summary, regions still report how many times they were entered.
+struct PerfCounters {
+ public:
+  enum Counter {
+    Cycles,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+  };
+  static constexpr size_t num_counters = 4;
+
+  static std::string_view counter_name(Counter counter);
+
+  struct Row {
+   public:
+    std::string name;
+    uint64_t calls = 0;
+    std::array<uint64_t, num_counters> values = {};
+  };
+
+  // Opens the counters for the calling thread.
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool is_available(Counter counter) const;
+
+  // Why counters are missing, if any are.
+  const std::optional<std::string>& unavailable_reason() const
+  {
+    return _unavailable_reason;
+  }
+
+  // Rows in the order their region was first entered.
+  const std::vector<Row>& rows() const { return _rows; }
+
+  // The summary table, one line per row.
+  std::vector<std::string> format_summary() const;
+
+  // The counters measuring this thread, or null.
+  static PerfCounters* current();
+
+  // Makes counters current on this thread for the lifetime of the scope.
+  struct Scope {
+   public:
+    explicit Scope(PerfCounters& counters);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    PerfCounters* _previous;
+  };
+
+  struct Region {
+   public:
+    explicit Region(const std::string_view& name);
+    ~Region();
+
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+
+   private:
+    PerfCounters* _counters;
+    size_t _row = 0;
+    std::array<uint64_t, num_counters> _start = {};
+  };
+
+ private:
+  // Current values, scaled up when the kernel multiplexed a counter.
+  std::array<uint64_t, num_counters> _read() const;
+
+  size_t _row(const std::string_view& name);
+
+  std::array<int, num_counters> _fds;
+  std::optional<std::string> _unavailable_reason;
+  std::vector<Row> _rows;
+};
+
+// Runs fn with performance counters current, then prints the summary to
+// log_output if destination is "-", or writes it to the file destination.
+// Failing to write the summary fails the invocation.
+int run_with_perf_counters(
+  const std::string& destination,
+  bee::LogOutput log_output,
+  const std::function<int()>& fn);
+
+} // namespace command
@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "command_builder.hpp"
+#include "perf_counters.hpp"
+
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace command {
+namespace {
+
+uint64_t busy_work(int n)
+{
+  uint64_t sum = 0;
+  for (int i = 0; i < n; i++) { sum = sum * 31 + i; }
+  return sum;
+}
+
+// The region and call columns of a summary. The counters depend on the
+// machine, and aren't available in every container.
+void print_summary(const vector<string>& lines)
+{
+  for (const auto& line : lines) {
+    if (line.starts_with("Not all counters")) { continue; }
+    std::istringstream words(line);
+    string region, calls;
+    words >> region >> calls;
+    P("$ $", region, calls);
+  }
+}
+
+TEST(regions)
+{
+  PerfCounters counters;
+  {
+    PerfCounters::Scope scope(counters);
+    PerfCounters::Region outer("outer");
+    for (int i = 0; i < 3; i++) {
+      PerfCounters::Region inner("inner");
+      busy_work(1000);
+    }
+  }
+  {
+    // Not measured, the counters aren't current anymore
+    PerfCounters::Region ignored("ignored");
+  }
+  print_summary(counters.format_summary());
+
+  bool consistent = true;
+  for (const auto& row : counters.rows()) {
+    for (size_t i = 0; i < PerfCounters::num_counters; i++) {
+      auto counter = PerfCounters::Counter(i);
+      if (!counters.is_available(counter) && row.values[i] != 0) {
+        consistent = false;
+      }
+    }
+  }
+  P("unavailable counters read as zero: $", consistent);
+  P("reason given when unavailable: $",
+    counters.unavailable_reason().has_value() ==
+      !(counters.is_available(PerfCounters::Cycles) &&
+        counters.is_available(PerfCounters::Instructions) &&
+        counters.is_available(PerfCounters::CacheMisses) &&
+        counters.is_available(PerfCounters::BranchMisses)));
+}
+
+Cmd make_command()
+{
+  auto builder = CommandBuilder("Works");
+  builder.perf_counters();
+  auto n = builder.optional_with_default("--n", flags::Int, 1000, "n");
+  return builder.run([=]() {
+    {
+      PerfCounters::Region region("decode");
+      busy_work(*n / 2);
+    }
+    PerfCounters::Region region("encode");
+    busy_work(*n / 2);
+    P("done");
+    return bee::ok();
+  });
+}
+
+void run(const Cmd& cmd, const vector<string>& args)
+{
+  int exit_code =
+    cmd.execute(bee::LogOutput::StdOut, bee::ArrayView<const string>(args));
+  P("exit_code=$", exit_code);
+}
+
+TEST(flag)
+{
+  auto cmd = make_command();
+  auto path = "/tmp/perf_counters_test_" + std::to_string(getpid());
+  run(cmd, {"--perf-counters", path});
+
+  std::ifstream file(path);
+  vector<string> lines;
+  for (string line; std::getline(file, line);) { lines.push_back(line); }
+  std::remove(path.c_str());
+  print_summary(lines);
+
+  P("--------------------------------------------");
+  run(cmd, {});
+
+  P("--------------------------------------------");
+  run(cmd, {"--perf-counters", "/nonexistent/summary"});
+
+  P("--------------------------------------------");
+  run(cmd, {"--help"});
+}
+
+} // namespace
+} // namespace command
@@ -0,0 +1,170 @@
+#include "plugin.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <dlfcn.h>
+
+#include "command_base.hpp"
+#include "io_util.hpp"
+
+#include "bee/print.hpp"
+
+namespace command {
+namespace {
+
+constexpr char manifest_name[] = "plugins";
+
+// Stands in for a plugin that couldn't be loaded, failing every invocation.
+struct FailedPlugin final : public CommandBase {
+ public:
+  FailedPlugin(const std::string_view& description, const bee::Error& error)
+      : CommandBase(description), _error(error)
+  {}
+
+  virtual int execute(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view>) const override
+  {
+    record_error(_error);
+    PF(log_output, "ERROR: $", _error);
+    return 1;
+  }
+
+ private:
+  const bee::Error _error;
+};
+
+bee::OrError<Cmd> load_plugin(
+  const std::string& path, const std::string_view& name)
+{
+  // Plugins are never unloaded once they provide the command, its code backs
+  // the returned command
+  void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    return bee::Error::fmt("Failed to load plugin '$': $", path, dlerror());
+  }
+  auto unload = [handle](const bee::Error& error) {
+    dlclose(handle);
+    return error;
+  };
+  auto version = static_cast<const uint32_t*>(
+    dlsym(handle, plugin_abi_version_symbol));
+  if (version == nullptr) {
+    return unload(bee::Error::fmt(
+      "Plugin '$' doesn't export $", path, plugin_abi_version_symbol));
+  }
+  if (*version != plugin_abi_version) {
+    return unload(bee::Error::fmt(
+      "Plugin '$' was built for plugin ABI version $, expected $",
+      path,
+      *version,
+      plugin_abi_version));
+  }
+  auto create =
+    reinterpret_cast<plugin_create_fn>(dlsym(handle, plugin_create_symbol));
+  if (create == nullptr) {
+    return unload(bee::Error::fmt(
+      "Plugin '$' doesn't export $", path, plugin_create_symbol));
+  }
+  std::optional<Cmd> cmd;
+  create(name, cmd);
+  if (!cmd.has_value()) {
+    return unload(
+      bee::Error::fmt("Plugin '$' didn't create command $", path, name));
+  }
+  return std::move(*cmd);
+}
+
+std::string_view next_word(std::string_view& line)
+{
+  size_t begin = line.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    line = {};
+    return {};
+  }
+  line.remove_prefix(begin);
+  size_t end = std::min(line.find_first_of(" \t"), line.size());
+  auto word = line.substr(0, end);
+  line.remove_prefix(end);
+  return word;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// PluginManifest
+//
+
+bee::OrError<std::vector<PluginManifest::Entry>> PluginManifest::parse(
+  const std::string_view& content)
+{
+  std::vector<Entry> entries;
+  size_t line_number = 0;
+  for (size_t begin = 0; begin < content.size();) {
+    line_number++;
+    size_t end = std::min(content.find('\n', begin), content.size());
+    std::string_view line = content.substr(begin, end - begin);
+    begin = end + 1;
+    if (!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+
+    auto name = next_word(line);
+    if (name.empty() || name.front() == '#') { continue; }
+    auto library = next_word(line);
+    if (library.empty()) {
+      return bee::Error::fmt(
+        "Line $: Expected '<name> <library> <description>'", line_number);
+    }
+    size_t description = line.find_first_not_of(" \t");
+    entries.push_back({
+      .name = std::string(name),
+      .library = std::string(library),
+      .description = description == std::string_view::npos
+                       ? std::string()
+                       : std::string(line.substr(description)),
+    });
+  }
+  return entries;
+}
+
+bee::OrError<std::vector<PluginManifest::Entry>> PluginManifest::read(
+  const std::string& directory)
+{
+  auto path = directory + "/" + manifest_name;
+  bail(content, io_util::read_file(path));
+  auto entries = parse(content);
+  if (entries.is_error()) {
+    return bee::Error::fmt(
+      "Failed to parse plugin manifest '$': $", path, entries.error());
+  }
+  return entries;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// add_plugins
+//
+
+bee::OrError<> add_plugins(GroupBuilder& builder, const std::string& directory)
+{
+  bail(entries, PluginManifest::read(directory));
+  builder.completion_input(directory + "/" + manifest_name);
+  for (auto& entry : entries) {
+    auto path = entry.library.starts_with('/')
+                  ? entry.library
+                  : directory + "/" + entry.library;
+    builder.lazy_cmd(
+      entry.name,
+      entry.description,
+      [path, name = entry.name, description = entry.description]() {
+        auto cmd = load_plugin(path, name);
+        if (cmd.is_error()) {
+          return Cmd(std::make_shared<FailedPlugin>(description, cmd.error()));
+        }
+        return std::move(*cmd);
+      });
+  }
+  return bee::ok();
+}
+
+} // namespace command
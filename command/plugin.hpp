@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cmd.hpp"
+#include "group_builder.hpp"
+
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Subcommands that live in shared objects, so a tool only maps the code of the
+// command it runs.
+//
+// A plugin directory has a manifest named `plugins` with one subcommand per
+// line:
+//
+//   <name> <library> <description...>
+//
+// Blank lines and lines starting with # are ignored. Each subcommand is added
+// as a lazy command, the library is only loaded with dlopen when the group
+// dispatches to it, and stays loaded. It must be built with COMMAND_PLUGIN
+// against the same version of this library as the tool, and leave the symbols
+// of this library undefined so they resolve to the tool's copy. Tools that call
+// add_plugins must be linked with -rdynamic (ld_flags on their own target, it
+// isn't set for every binary since exporting all symbols slows down startup).
+// Plugins built against another version of the interface are refused when
+// loaded, see plugin_abi_version.
+struct PluginManifest {
+ public:
+  struct Entry {
+   public:
+    std::string name;
+    std::string library;
+    std::string description;
+  };
+
+  static bee::OrError<std::vector<Entry>> parse(
+    const std::string_view& content);
+
+  static bee::OrError<std::vector<Entry>> read(const std::string& directory);
+};
+
+// Adds the subcommands listed in the manifest of directory to builder.
+bee::OrError<> add_plugins(GroupBuilder& builder, const std::string& directory);
+
+// Name of the function exported by plugins, see COMMAND_PLUGIN.
+inline constexpr char plugin_create_symbol[] = "command_plugin_create";
+
+using plugin_create_fn = void (*)(std::string_view, std::optional<Cmd>&);
+
+// Plugins export the version of the interface they were built against, and
+// are refused unless it matches the tool's. Bump it whenever Cmd, CommandBase
+// or plugin_create_fn change in a way that breaks plugins built before.
+inline constexpr char plugin_abi_version_symbol[] =
+  "command_plugin_abi_version";
+inline constexpr uint32_t plugin_abi_version = 1;
+
+} // namespace command
+
+// Exports the entry point of a plugin. function takes the name of the
+// subcommand from the manifest, so one library can provide several, and
+// returns its Cmd:
+//
+//   command::Cmd create(std::string_view name) { ... }
+//   COMMAND_PLUGIN(create)
+#define COMMAND_PLUGIN(function)                                               \
+  extern "C" const uint32_t command_plugin_abi_version =                       \
+    ::command::plugin_abi_version;                                             \
+  extern "C" void command_plugin_create(                                       \
+    std::string_view name, std::optional<::command::Cmd>& out)                 \
+  {                                                                            \
+    out.emplace(function(name));                                               \
+  }
@@ -0,0 +1,108 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "group_builder.hpp"
+#include "plugin.hpp"
+
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace command {
+namespace {
+
+constexpr char plugin_dir[] = "plugin_test_dir";
+
+void run_cmd(const vector<string_view>& args, const Cmd& cmd)
+{
+  int exit_code = cmd.execute(
+    bee::LogOutput::StdOut, bee::ArrayView<const string_view>(args));
+  P("exit_code=$", exit_code);
+}
+
+TEST(manifest)
+{
+  auto run = [](const string_view& content) {
+    auto entries = PluginManifest::parse(content);
+    if (entries.is_error()) {
+      P("Error: $", entries.error());
+      return;
+    }
+    for (const auto& entry : *entries) {
+      P("name:'$' library:'$' description:'$'",
+        entry.name,
+        entry.library,
+        entry.description);
+    }
+    P("--------------------------------------------");
+  };
+  run("# Comment\n"
+      "deploy libdeploy.so Deploys the service\n"
+      "\n"
+      "  status\t/opt/tools/libstatus.so   Shows the status\r\n"
+      "bare libbare.so\n");
+  run("deploy\n");
+}
+
+// The test plugins are built next to this binary
+string built_plugin(const string& name)
+{
+  char exe[4096];
+  ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  string dir = n > 0 ? string(exe, n) : string();
+  return dir.substr(0, dir.rfind('/') + 1) + name;
+}
+
+TEST(add_plugins)
+{
+  mkdir(plugin_dir, 0755);
+  const string dir = plugin_dir;
+  symlink(built_plugin("plugin_test_plugin.so").c_str(),
+          (dir + "/libgreet.so").c_str());
+  symlink(built_plugin("plugin_test_old_plugin.so").c_str(),
+          (dir + "/libold.so").c_str());
+  {
+    std::ofstream manifest(dir + "/plugins");
+    manifest << "greet libgreet.so Greets from a plugin\n";
+    manifest << "hi libgreet.so Same library, another command\n";
+    manifest << "old libold.so Built against an older interface\n";
+    manifest << "status libmissing.so Shows the status\n";
+  }
+
+  // Listing the commands doesn't load any library
+  auto builder = GroupBuilder("group");
+  P(add_plugins(builder, plugin_dir));
+  auto grp = builder.build();
+  run_cmd({"help"}, grp);
+
+  P("--------------------------------------------");
+  run_cmd({"greet", "--name", "world"}, grp);
+  run_cmd({"hi", "--name", "again"}, grp);
+  run_cmd({"greet"}, grp);
+
+  P("--------------------------------------------");
+  run_cmd({"old"}, grp);
+
+  P("--------------------------------------------");
+  run_cmd({"status"}, grp);
+
+  P("--------------------------------------------");
+  auto other = GroupBuilder("other");
+  P(add_plugins(other, "no_such_dir"));
+
+  for (const char* file : {"plugins", "libgreet.so", "libold.so"}) {
+    unlink((dir + "/" + file).c_str());
+  }
+  rmdir(plugin_dir);
+}
+
+} // namespace
+} // namespace command
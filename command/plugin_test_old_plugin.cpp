@@ -0,0 +1,16 @@
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "cmd.hpp"
+
+// A plugin built against an older version of the plugin interface, which
+// plugin_test expects to be refused. Its entry point must never be called.
+
+extern "C" const uint32_t command_plugin_abi_version = 0;
+
+extern "C" void command_plugin_create(
+  std::string_view, std::optional<command::Cmd>&)
+{
+  __builtin_trap();
+}
@@ -0,0 +1,26 @@
+#include <string>
+#include <string_view>
+
+#include "command_builder.hpp"
+#include "plugin.hpp"
+
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+
+// The plugin plugin_test loads, built as a shared object.
+
+namespace {
+
+command::Cmd create(std::string_view name)
+{
+  auto builder = command::CommandBuilder("Greets from a plugin");
+  auto who = builder.required("--name", command::flags::String);
+  return builder.run([=, name = std::string(name)]() -> bee::OrError<> {
+    P("Hello $, from plugin command $", *who, name);
+    return bee::ok();
+  });
+}
+
+} // namespace
+
+COMMAND_PLUGIN(create)
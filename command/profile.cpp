@@ -0,0 +1,208 @@
+#include "profile.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "bee/print.hpp"
+
+namespace command {
+
+namespace profile_detail {
+
+thread_local size_t allocations = 0;
+bool counting_allocations = false;
+
+} // namespace profile_detail
+
+namespace {
+
+thread_local Profiler* current_profiler = nullptr;
+
+// Construction of the tree, as steady clock ticks, zero until the first
+// command is constructed
+std::atomic<Profiler::clock::rep> construction_start = 0;
+std::atomic<Profiler::clock::rep> construction_end = 0;
+std::atomic<size_t> construction_allocations_start = 0;
+std::atomic<size_t> construction_allocations_end = 0;
+
+void append_escaped(std::string& out, const std::string_view& str)
+{
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out += buffer;
+    } else {
+      out += c;
+    }
+  }
+}
+
+// Chrome traces are in microseconds, fractions keep the nanoseconds
+void append_micros(std::string& out, const std::chrono::nanoseconds& ns)
+{
+  char buffer[32];
+  snprintf(
+    buffer,
+    sizeof(buffer),
+    "%lld.%03lld",
+    static_cast<long long>(ns.count() / 1000),
+    static_cast<long long>(ns.count() % 1000));
+  out += buffer;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// Profiler
+//
+
+Profiler::Profiler()
+{
+  _events.reserve(64);
+  auto start = construction_start.load();
+  if (start != 0) {
+    _events.push_back({
+      .name = "construction",
+      .start = clock::time_point(clock::duration(start)),
+      .end = clock::time_point(clock::duration(construction_end.load())),
+      .allocations = construction_allocations_end.load() -
+                     construction_allocations_start.load(),
+    });
+  }
+}
+
+Profiler::~Profiler() {}
+
+Profiler* Profiler::current() { return current_profiler; }
+
+Profiler::Scope::Scope(Profiler& profiler) : _previous(current_profiler)
+{
+  current_profiler = &profiler;
+}
+
+Profiler::Scope::~Scope() { current_profiler = _previous; }
+
+Profiler::Span::Span(
+  const std::string_view& name, const std::string_view& detail)
+    : _profiler(current_profiler)
+{
+  if (_profiler == nullptr) { return; }
+  size_t before = profile_detail::allocations;
+  _event = _profiler->_events.size();
+  auto& event = _profiler->_events.emplace_back();
+  event.name = name;
+  if (!detail.empty()) {
+    event.name += ' ';
+    event.name += detail;
+  }
+  _profiler->_overhead += profile_detail::allocations - before;
+  // Holds the count at the start until the span ends
+  event.allocations = _profiler->_allocations();
+  event.start = clock::now();
+}
+
+Profiler::Span::~Span()
+{
+  if (_profiler == nullptr) { return; }
+  auto end = clock::now();
+  auto& event = _profiler->_events[_event];
+  event.end = end;
+  event.allocations = _profiler->_allocations() - event.allocations;
+}
+
+void Profiler::note_construction()
+{
+  if (current_profiler != nullptr) { return; }
+  auto now = clock::now().time_since_epoch().count();
+  clock::rep unset = 0;
+  if (construction_start.compare_exchange_strong(unset, now)) {
+    construction_allocations_start = profile_detail::allocations;
+  }
+  construction_end = now;
+  construction_allocations_end = profile_detail::allocations;
+}
+
+size_t Profiler::_allocations() const
+{
+  return profile_detail::allocations - _overhead;
+}
+
+bee::OrError<> Profiler::write(const std::string& path) const
+{
+  auto origin = _events.empty() ? clock::time_point() : _events.front().start;
+  auto pid = std::to_string(getpid());
+  auto tid = std::to_string(gettid());
+
+  std::string out = "{\"traceEvents\":[";
+  for (size_t i = 0; i < _events.size(); i++) {
+    const auto& event = _events[i];
+    if (i > 0) { out += ','; }
+    out += "\n{\"name\":\"";
+    append_escaped(out, event.name);
+    out += "\",\"cat\":\"command\",\"ph\":\"X\",\"pid\":" + pid +
+           ",\"tid\":" + tid + ",\"ts\":";
+    append_micros(out, event.start - origin);
+    out += ",\"dur\":";
+    append_micros(out, event.end - event.start);
+    if (profile_detail::counting_allocations) {
+      out += ",\"args\":{\"allocations\":";
+      out += std::to_string(event.allocations);
+      out += '}';
+    }
+    out += '}';
+  }
+  out += "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+  FILE* file = fopen(path.c_str(), "we");
+  if (file == nullptr) {
+    return bee::Error::fmt("Failed to open $: $", path, strerror(errno));
+  }
+  bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    return bee::Error::fmt("Failed to write $: $", path, strerror(errno));
+  }
+  return bee::ok();
+}
+
+int run_profiled(
+  const std::string& path,
+  const bee::LogOutput log_output,
+  const std::function<int()>& fn)
+{
+  return run_profiled(log_output, [&](std::optional<std::string>& dest) {
+    dest = path;
+    return fn();
+  });
+}
+
+int run_profiled(
+  const bee::LogOutput log_output,
+  const std::function<int(std::optional<std::string>& path)>& fn)
+{
+  Profiler profiler;
+  std::optional<std::string> path;
+  int exit_code;
+  {
+    Profiler::Scope scope(profiler);
+    Profiler::Span span("invocation");
+    exit_code = fn(path);
+  }
+  if (!path.has_value()) { return exit_code; }
+  auto err = profiler.write(*path);
+  if (err.is_error()) {
+    PF(log_output, "ERROR: Failed to write profile: $", err.error());
+    return exit_code == 0 ? 1 : exit_code;
+  }
+  return exit_code;
+}
+
+} // namespace command
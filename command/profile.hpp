@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bee/log_output.hpp"
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Records timed spans of an invocation, for the --profile flag that commands
+// and groups can accept, see CommandBuilder::profile and
+// GroupBuilder::profile. The code being timed opens a Profiler::Span, which
+// does nothing unless a profiler is current on the thread, so the spans cost a
+// thread local read when profiling is off.
+//
+// Heap allocations are counted per span when the binary links the
+// profile_allocations library, which replaces the global operator new.
+// Allocations made by the profiler itself are left out.
+struct Profiler {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  struct Event {
+   public:
+    std::string name;
+    clock::time_point start;
+    clock::time_point end;
+    size_t allocations = 0;
+  };
+
+  Profiler();
+  ~Profiler();
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  // The profiler recording on this thread, or null.
+  static Profiler* current();
+
+  // Makes a profiler current on this thread for the lifetime of the scope.
+  struct Scope {
+   public:
+    explicit Scope(Profiler& profiler);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Profiler* _previous;
+  };
+
+  // Records the time between its construction and destruction as an event
+  // named "<name> <detail>".
+  struct Span {
+   public:
+    explicit Span(
+      const std::string_view& name, const std::string_view& detail = {});
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+   private:
+    Profiler* _profiler;
+    size_t _event = 0;
+  };
+
+  // Called as commands and builders are constructed. The time from the first
+  // call to the last one before an invocation is profiled is reported as the
+  // construction of the tree.
+  static void note_construction();
+
+  // Events in the order they started, the construction of the tree first.
+  const std::vector<Event>& events() const { return _events; }
+
+  // Writes the events in the Chrome trace format, which chrome://tracing and
+  // Perfetto load.
+  bee::OrError<> write(const std::string& path) const;
+
+ private:
+  // Allocations made on this thread, less the ones made by the profiler.
+  size_t _allocations() const;
+
+  std::vector<Event> _events;
+  size_t _overhead = 0;
+};
+
+// Runs fn with a profiler current and writes the trace to path. Failing to
+// write the trace is reported to log_output and fails the invocation.
+int run_profiled(
+  const std::string& path,
+  bee::LogOutput log_output,
+  const std::function<int()>& fn);
+
+// Same, for callers that only learn whether to profile while running, e.g.
+// from their parsed arguments. fn sets path to where the trace goes, the trace
+// is discarded if it doesn't.
+int run_profiled(
+  bee::LogOutput log_output,
+  const std::function<int(std::optional<std::string>& path)>& fn);
+
+namespace profile_detail {
+
+// Maintained by the profile_allocations library.
+extern thread_local size_t allocations;
+extern bool counting_allocations;
+
+} // namespace profile_detail
+
+} // namespace command
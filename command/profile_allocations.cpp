@@ -0,0 +1,97 @@
+// Counts heap allocations for Profiler, see profile.hpp. Linking this library
+// replaces the global operator new and delete.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "profile.hpp"
+
+namespace {
+
+void* allocate(size_t size, size_t alignment)
+{
+  command::profile_detail::allocations++;
+  if (size == 0) { size = 1; }
+  while (true) {
+    size_t rounded = (size + alignment - 1) / alignment * alignment;
+    void* ptr = alignment <= alignof(std::max_align_t)
+                  ? std::malloc(size)
+                  : std::aligned_alloc(alignment, rounded);
+    if (ptr != nullptr) { return ptr; }
+    auto handler = std::get_new_handler();
+    if (handler == nullptr) { throw std::bad_alloc(); }
+    handler();
+  }
+}
+
+void* allocate_nothrow(size_t size, size_t alignment) noexcept
+{
+  try {
+    return allocate(size, alignment);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+[[maybe_unused]] const bool registered =
+  (command::profile_detail::counting_allocations = true);
+
+constexpr size_t default_alignment = alignof(std::max_align_t);
+
+} // namespace
+
+void* operator new(size_t size) { return allocate(size, default_alignment); }
+void* operator new[](size_t size) { return allocate(size, default_alignment); }
+void* operator new(size_t size, std::align_val_t align)
+{
+  return allocate(size, size_t(align));
+}
+void* operator new[](size_t size, std::align_val_t align)
+{
+  return allocate(size, size_t(align));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate_nothrow(size, default_alignment);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate_nothrow(size, default_alignment);
+}
+void* operator new(
+  size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+  return allocate_nothrow(size, size_t(align));
+}
+void* operator new[](
+  size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+  return allocate_nothrow(size, size_t(align));
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
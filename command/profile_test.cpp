@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "command_builder.hpp"
+#include "group_builder.hpp"
+#include "profile.hpp"
+
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace command {
+namespace {
+
+Cmd make_command(bool profile_flag)
+{
+  auto builder = CommandBuilder("Greets");
+  if (profile_flag) { builder.profile(); }
+  auto name = builder.required("--name", flags::String, "name");
+  auto times = builder.optional("--times", flags::Int, "n");
+  auto extra = builder.repeated_anon(flags::String, "extra");
+  return builder.run([=]() {
+    for (int i = 0; i < times->value_or(1); i++) { P("Hello $", *name); }
+    return bee::ok();
+  });
+}
+
+string trace_path()
+{
+  return "/tmp/profile_test_" + std::to_string(getpid()) + ".json";
+}
+
+// The names of the events in a trace, and whether it counted allocations,
+// without the timings, which change from run to run.
+void print_trace(const string& path)
+{
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  const string trace = content.str();
+  std::remove(path.c_str());
+
+  P("starts as a trace: $", trace.starts_with("{\"traceEvents\":["));
+  P("counts allocations: $",
+    trace.find("\"allocations\":") != string::npos);
+  const string key = "\"name\":\"";
+  for (size_t pos = trace.find(key); pos != string::npos;
+       pos = trace.find(key, pos)) {
+    pos += key.size();
+    P("  $", trace.substr(pos, trace.find('"', pos) - pos));
+  }
+}
+
+void run(const Cmd& cmd, const vector<string>& args)
+{
+  int exit_code =
+    cmd.execute(bee::LogOutput::StdOut, bee::ArrayView<const string>(args));
+  P("exit_code=$", exit_code);
+}
+
+TEST(spans)
+{
+  auto cmd = make_command(false);
+  Profiler profiler;
+  {
+    Profiler::Scope scope(profiler);
+    run(cmd, {"--name", "world", "--times", "2", "a", "b"});
+  }
+  for (const auto& event : profiler.events()) {
+    P("$: end after start: $", event.name, event.end >= event.start);
+  }
+}
+
+TEST(no_profiler)
+{
+  // Spans are ignored when no profiler is current
+  Profiler::Span span("ignored");
+  P("current: $", Profiler::current() != nullptr);
+}
+
+TEST(command_flag)
+{
+  auto cmd = make_command(true);
+  auto path = trace_path();
+  run(cmd, {"--name", "world", "--profile", path});
+  print_trace(path);
+
+  P("--------------------------------------------");
+  run(cmd, {"--name", "world"});
+  P("trace written: $", access(path.c_str(), F_OK) == 0);
+
+  P("--------------------------------------------");
+  run(cmd, {"--help"});
+}
+
+TEST(group_flag)
+{
+  auto inner = GroupBuilder("Inner").cmd("greet", make_command(false)).build();
+  auto lazy = [] { return make_command(false); };
+  auto group = GroupBuilder("Tool")
+                 .profile()
+                 .cmd("inner", inner)
+                 .lazy_cmd("lazy", "Built on dispatch", lazy)
+                 .build();
+
+  auto path = trace_path();
+  run(group, {"--profile", path, "inner", "greet", "--name", "world"});
+  print_trace(path);
+
+  P("--------------------------------------------");
+  run(group, {"--profile=" + path, "lazy", "--name", "world"});
+  print_trace(path);
+
+  P("--------------------------------------------");
+  run(group, {"--profile"});
+
+  P("--------------------------------------------");
+  run(group, {"help"});
+}
+
+// Counts how many times a value is parsed
+struct CountingSpec {
+ public:
+  using value_type = string;
+  std::shared_ptr<int> calls = std::make_shared<int>(0);
+
+  bee::OrError<string> of_string(const std::string_view& str) const
+  {
+    ++*calls;
+    return string(str);
+  }
+  string to_string(const string& value) const { return value; }
+};
+
+TEST(parses_once)
+{
+  CountingSpec spec;
+  auto builder = CommandBuilder("Greets");
+  builder.profile();
+  auto name = builder.required("--name", spec, "name");
+  auto cmd = builder.run([=]() {
+    P("Hello $", *name);
+    return bee::ok();
+  });
+
+  auto path = trace_path();
+  run(cmd, {"--name", "world", "--profile", path});
+  std::remove(path.c_str());
+  P("of_string calls with --profile: $", *spec.calls);
+
+  *spec.calls = 0;
+  run(cmd, {"--name", "world"});
+  P("of_string calls without: $", *spec.calls);
+}
+
+TEST(write_error)
+{
+  auto cmd = make_command(true);
+  run(cmd, {"--name", "world", "--profile", "/nonexistent/trace.json"});
+}
+
+} // namespace
+} // namespace command
@@ -0,0 +1,197 @@
+#include "response_file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string_view;
+
+namespace command {
+namespace {
+
+bool is_response_file(const string_view& arg)
+{
+  return arg.size() > 1 && arg.front() == '@';
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// ResponseFile
+//
+
+ResponseFile::ResponseFile(char* data, size_t size)
+    : _data(data), _size(size), _mapped(data != nullptr)
+{}
+
+ResponseFile::ResponseFile(std::string content)
+    : _data(nullptr), _size(content.size()), _mapped(false)
+{
+  _content = std::move(content);
+  _data = _content.data();
+}
+
+ResponseFile::~ResponseFile()
+{
+  if (_mapped) { munmap(_data, _size); }
+}
+
+bee::OrError<ResponseFile::ptr> ResponseFile::open(const string_view& path)
+{
+  std::string path_str(path);
+  int fd = ::open(path_str.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return bee::Error::fmt(
+      "Failed to open response file '$': $", path, strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int err = errno;
+    close(fd);
+    return bee::Error::fmt(
+      "Failed to stat response file '$': $", path, strerror(err));
+  }
+
+  ptr file;
+  if (!S_ISREG(st.st_mode)) {
+    // Pipes and process substitutions can't be mapped and report no size,
+    // they are read until the end instead
+    auto content = _read_all(fd);
+    if (content.is_error()) {
+      close(fd);
+      return bee::Error::fmt(
+        "Failed to read response file '$': $", path, content.error());
+    }
+    file = ptr(new ResponseFile(std::move(content.value())));
+  } else if (st.st_size > 0) {
+    // Mapped privately and writable so quoted arguments can be unescaped in
+    // place without touching the file.
+    size_t size = st.st_size;
+    void* addr =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      int err = errno;
+      close(fd);
+      return bee::Error::fmt(
+        "Failed to map response file '$': $", path, strerror(err));
+    }
+    file = ptr(new ResponseFile(static_cast<char*>(addr), size));
+  } else {
+    file = ptr(new ResponseFile(nullptr, 0));
+  }
+  close(fd);
+
+  auto err = file->_tokenize();
+  if (err.is_error()) {
+    return bee::Error::fmt(
+      "Failed to parse response file '$': $", path, err.error());
+  }
+  return file;
+}
+
+bee::OrError<std::string> ResponseFile::_read_all(int fd)
+{
+  std::string content;
+  char buffer[1 << 16];
+  while (true) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n == -1) {
+      if (errno == EINTR) { continue; }
+      return bee::Error(strerror(errno));
+    }
+    if (n == 0) { return content; }
+    content.append(buffer, n);
+  }
+}
+
+bee::OrError<> ResponseFile::_tokenize()
+{
+  if (_size == 0) { return bee::ok(); }
+  char* const end = _data + _size;
+
+  if (std::memchr(_data, '\0', _size) != nullptr) {
+    _args.reserve(std::count(_data, end, '\0') + 1);
+    for (char* p = _data; p < end;) {
+      char* next = static_cast<char*>(std::memchr(p, '\0', end - p));
+      if (next == nullptr) { next = end; }
+      _args.emplace_back(p, next - p);
+      p = next == end ? end : next + 1;
+    }
+    return bee::ok();
+  }
+
+  _args.reserve(std::count(_data, end, '\n') + 1);
+  for (char* p = _data; p < end;) {
+    if (*p == '"') {
+      char* out = p;
+      char* in = p + 1;
+      while (in < end && *in != '"') {
+        if (*in == '\\' && in + 1 < end && (in[1] == '"' || in[1] == '\\')) {
+          in++;
+        }
+        *out++ = *in++;
+      }
+      if (in == end) { return bee::Error("Unterminated quoted argument"); }
+      _args.emplace_back(p, out - p);
+      p = in + 1;
+      if (p < end && *p == '\r') { p++; }
+      if (p < end && *p != '\n') {
+        return bee::Error("Unexpected characters after quoted argument");
+      }
+      if (p < end) { p++; }
+      continue;
+    }
+
+    char* next = static_cast<char*>(std::memchr(p, '\n', end - p));
+    if (next == nullptr) { next = end; }
+    char* token_end = next;
+    if (token_end > p && token_end[-1] == '\r') { token_end--; }
+    if (token_end > p) { _args.emplace_back(p, token_end - p); }
+    p = next == end ? end : next + 1;
+  }
+  return bee::ok();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// expand_response_files
+//
+
+bool has_response_files(const bee::ArrayView<const string_view>& args)
+{
+  for (const auto& arg : args) {
+    if (arg == "--") { return false; }
+    if (is_response_file(arg)) { return true; }
+  }
+  return false;
+}
+
+bee::OrError<> expand_response_files(
+  const bee::ArrayView<const string_view>& args, ExpandedArgs& expanded)
+{
+  bool flag_escaped = false;
+  for (const auto& arg : args) {
+    if (!flag_escaped && arg.starts_with("@@")) {
+      expanded.args.push_back(arg.substr(1));
+    } else if (!flag_escaped && is_response_file(arg)) {
+      bail(file, ResponseFile::open(arg.substr(1)));
+      const auto& file_args = file->args();
+      expanded.args.insert(
+        expanded.args.end(), file_args.begin(), file_args.end());
+      expanded.files.push_back(std::move(file));
+    } else {
+      if (arg == "--") { flag_escaped = true; }
+      expanded.args.push_back(arg);
+    }
+  }
+  return bee::ok();
+}
+
+} // namespace command
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bee/array_view.hpp"
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// A file of arguments, passed on the command line as @path. Regular files are
+// mapped in memory privately, anything else (pipes, process substitutions) is
+// read into memory. The arguments are views into that memory, so they are
+// only valid while the ResponseFile is alive.
+//
+// If the file contains a NUL byte, arguments are NUL terminated (as produced
+// by find -print0). Otherwise there is one argument per line, empty lines are
+// ignored and an argument that starts with a double quote extends to the
+// matching quote, which allows empty arguments and arguments with newlines.
+// Inside quotes \" and \\ are unescaped in place.
+//
+// Expansion is opt-in, see CommandBuilder::response_files, since it changes
+// the meaning of existing arguments that start with @.
+struct ResponseFile {
+ public:
+  using ptr = std::unique_ptr<ResponseFile>;
+
+  static bee::OrError<ptr> open(const std::string_view& path);
+
+  ~ResponseFile();
+
+  ResponseFile(const ResponseFile&) = delete;
+  ResponseFile& operator=(const ResponseFile&) = delete;
+
+  const std::vector<std::string_view>& args() const { return _args; }
+
+ private:
+  // Takes ownership of a mapping of size bytes at data, or of content
+  ResponseFile(char* data, size_t size);
+  explicit ResponseFile(std::string content);
+
+  static bee::OrError<std::string> _read_all(int fd);
+
+  bee::OrError<> _tokenize();
+
+  char* _data;
+  size_t _size;
+  bool _mapped;
+  std::string _content;
+  std::vector<std::string_view> _args;
+};
+
+struct ExpandedArgs {
+ public:
+  explicit ExpandedArgs(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : args(resource), files(resource)
+  {}
+
+  bee::ArrayView<const std::string_view> view() const
+  {
+    return bee::ArrayView<const std::string_view>(args.data(), args.size());
+  }
+
+  std::pmr::vector<std::string_view> args;
+  std::pmr::vector<ResponseFile::ptr> files;
+};
+
+bool has_response_files(const bee::ArrayView<const std::string_view>& args);
+
+// Replaces every @path argument with the contents of the file, and every @@arg
+// with the literal @arg. Arguments after "--" are left untouched and response
+// files are not expanded recursively.
+bee::OrError<> expand_response_files(
+  const bee::ArrayView<const std::string_view>& args, ExpandedArgs& expanded);
+
+} // namespace command
@@ -0,0 +1,430 @@
+#include "schema.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "command_base.hpp"
+#include "command_builder.hpp"
+#include "schema_format.hpp"
+
+#include "bee/print.hpp"
+#include "bee/string_util.hpp"
+
+namespace command {
+namespace {
+
+namespace sf = schema_format;
+
+using collector_type = std::function<void(SchemaArgs&)>;
+
+// The mapped schema file. Every access is bounds checked, the file is only
+// checked as far as it's read.
+struct Mapping {
+ public:
+  static bee::OrError<std::shared_ptr<Mapping>> open(const std::string& path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      return bee::Error::fmt(
+        "Failed to open schema '$': $", path, strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      int err = errno;
+      close(fd);
+      return bee::Error::fmt(
+        "Failed to stat schema '$': $", path, strerror(err));
+    }
+    size_t size = st.st_size;
+    if (size < sizeof(sf::Header)) {
+      close(fd);
+      return bee::Error::fmt("Schema '$' is truncated", path);
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+      return bee::Error::fmt(
+        "Failed to map schema '$': $", path, strerror(err));
+    }
+
+    auto mapping =
+      std::shared_ptr<Mapping>(new Mapping(static_cast<char*>(data), size));
+    const auto& header = mapping->_header();
+    if (std::memcmp(header.magic, sf::magic, sizeof(sf::magic)) != 0) {
+      return bee::Error::fmt("'$' is not a command schema", path);
+    }
+    if (header.version != sf::version) {
+      return bee::Error::fmt(
+        "Schema '$' has version $, expected $",
+        path,
+        header.version,
+        sf::version);
+    }
+    uint64_t expected_size = sizeof(sf::Header) +
+                             uint64_t(header.num_nodes) * sizeof(sf::Node) +
+                             uint64_t(header.num_flags) * sizeof(sf::Flag) +
+                             header.strings_size;
+    if (expected_size != size || header.num_nodes == 0) {
+      return bee::Error::fmt("Schema '$' is corrupted", path);
+    }
+    return mapping;
+  }
+
+  ~Mapping() { munmap(_data, _size); }
+
+  Mapping(const Mapping&) = delete;
+  Mapping& operator=(const Mapping&) = delete;
+
+  bee::OrError<const sf::Node*> node(uint32_t index) const
+  {
+    const auto& header = _header();
+    if (index >= header.num_nodes) {
+      return bee::Error("Schema node out of bounds");
+    }
+    const auto* node = _nodes() + index;
+    if (
+      node->kind != sf::NodeKind::Group &&
+      node->kind != sf::NodeKind::Command) {
+      return bee::Error("Schema node has an unknown kind");
+    }
+    if (
+      node->kind == sf::NodeKind::Group &&
+      uint64_t(node->first_child) + node->num_children > header.num_nodes) {
+      return bee::Error("Schema children out of bounds");
+    }
+    // Nodes are laid out breadth first, so children always come after their
+    // group, which also rules out cycles when walking the tree
+    if (node->kind == sf::NodeKind::Group && node->first_child <= index) {
+      return bee::Error("Schema children out of order");
+    }
+    if (
+      node->kind == sf::NodeKind::Command &&
+      uint64_t(node->first_flag) + node->num_flags > header.num_flags) {
+      return bee::Error("Schema flags out of bounds");
+    }
+    return node;
+  }
+
+  const sf::Flag& flag(uint32_t index) const
+  {
+    // Range checked by node()
+    return reinterpret_cast<const sf::Flag*>(
+      _nodes() + _header().num_nodes)[index];
+  }
+
+  bee::OrError<std::string_view> str(const sf::String& str) const
+  {
+    const auto& header = _header();
+    if (uint64_t(str.offset) + str.size > header.strings_size) {
+      return bee::Error("Schema string out of bounds");
+    }
+    const char* strings = _data + _size - header.strings_size;
+    return std::string_view(strings + str.offset, str.size);
+  }
+
+ private:
+  Mapping(char* data, size_t size) : _data(data), _size(size) {}
+
+  const sf::Header& _header() const
+  {
+    return *reinterpret_cast<const sf::Header*>(_data);
+  }
+
+  const sf::Node* _nodes() const
+  {
+    return reinterpret_cast<const sf::Node*>(_data + sizeof(sf::Header));
+  }
+
+  char* const _data;
+  const size_t _size;
+};
+
+template <class S>
+bee::OrError<> add_flag(
+  CommandBuilder& builder,
+  const sf::FlagKind kind,
+  const std::string_view& name,
+  const opt_strview& doc,
+  const S& spec,
+  std::vector<collector_type>& collectors)
+{
+  using value_type = typename S::value_type;
+  std::string key(name);
+  switch (kind) {
+  case sf::FlagKind::NoArg:
+    return bee::Error::fmt("Flag $ takes no value, but has a spec", name);
+  case sf::FlagKind::Optional: {
+    auto flag = builder.optional(name, spec, std::nullopt, doc);
+    collectors.push_back([=](SchemaArgs& args) {
+      if (flag->has_value()) { args.set(key, **flag); }
+    });
+  } break;
+  case sf::FlagKind::Required: {
+    auto flag = builder.required(name, spec, std::nullopt, doc);
+    collectors.push_back([=](SchemaArgs& args) { args.set(key, *flag); });
+  } break;
+  case sf::FlagKind::Anon: {
+    auto flag = builder.anon(spec, name, doc);
+    collectors.push_back([=](SchemaArgs& args) {
+      if (flag->has_value()) { args.set(key, **flag); }
+    });
+  } break;
+  case sf::FlagKind::RequiredAnon: {
+    auto flag = builder.required_anon(spec, name, doc);
+    collectors.push_back([=](SchemaArgs& args) { args.set(key, *flag); });
+  } break;
+  case sf::FlagKind::RepeatedAnon: {
+    auto flag = builder.repeated_anon(spec, name, doc);
+    collectors.push_back([=](SchemaArgs& args) {
+      args.set(key, std::vector<value_type>(flag->begin(), flag->end()));
+    });
+  } break;
+  default:
+    return bee::Error::fmt("Flag $ has an unknown kind", name);
+  }
+  return bee::ok();
+}
+
+// A group of the schema, dispatching through the mapped tree.
+struct SchemaGroup final : public CommandBase {
+ public:
+  SchemaGroup(
+    const std::string_view& description,
+    const std::string& path,
+    std::shared_ptr<const Mapping>&& mapping,
+    std::shared_ptr<const SchemaHandlers>&& handlers)
+      : CommandBase(description),
+        _path(path),
+        _mapping(std::move(mapping)),
+        _handlers(std::move(handlers))
+  {}
+
+  virtual int execute(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view> args) const override
+  {
+    auto exit_code = _execute(log_output, args);
+    if (exit_code.is_error()) {
+      record_error(exit_code.error());
+      PF(log_output, "ERROR: $", exit_code.error());
+      return 1;
+    }
+    return *exit_code;
+  }
+
+  virtual void describe(CompletionTree& tree) const override
+  {
+    tree.inputs.push_back(_path);
+    auto root = _mapping->node(0);
+    if (!root.is_error()) { std::ignore = _describe(**root, tree); }
+  }
+
+ private:
+  bee::OrError<> _describe(const sf::Node& node, CompletionTree& tree) const
+  {
+    if (node.kind == sf::NodeKind::Group) {
+      tree.subcommands.push_back({.name = "help", .tree = {}});
+      for (uint32_t i = 0; i < node.num_children; i++) {
+        bail(child, _mapping->node(node.first_child + i));
+        bail(name, _mapping->str(child->name));
+        auto& subcommand =
+          tree.subcommands.emplace_back(std::string(name), CompletionTree{});
+        bail_unit(_describe(*child, subcommand.tree));
+      }
+      return bee::ok();
+    }
+    for (uint32_t i = 0; i < node.num_flags; i++) {
+      const auto& flag = _mapping->flag(node.first_flag + i);
+      bail(name, _mapping->str(flag.name));
+      switch (flag.kind) {
+      case sf::FlagKind::NoArg:
+        tree.flags.push_back({.name = std::string(name), .value_name = {}});
+        break;
+      case sf::FlagKind::Optional:
+      case sf::FlagKind::Required:
+        tree.flags.push_back({.name = std::string(name), .value_name = "_"});
+        break;
+      default:
+        break;
+      }
+    }
+    tree.flags.push_back({.name = "--help", .value_name = {}});
+    return bee::ok();
+  }
+
+  bee::OrError<int> _execute(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view> args) const
+  {
+    bail(node, _mapping->node(0));
+    size_t depth = 0;
+    while (node->kind == sf::NodeKind::Group) {
+      if (depth == args.size()) {
+        record_error(bee::Error("No arguments given"));
+        PF(log_output, "ERROR: No arguments given\n");
+        bail_unit(_print_help(log_output, *node));
+        return 1;
+      }
+      const auto& token = args[depth++];
+      bail(child, _find_child(*node, token));
+      if (child != nullptr) {
+        node = child;
+      } else if (token == "help") {
+        bail_unit(_print_help(log_output, *node));
+        return 0;
+      } else {
+        record_error(bee::Error::fmt("Unknown command: $", token));
+        PF(log_output, "Unknown command: $", token);
+        bail_unit(_print_help(log_output, *node));
+        return 1;
+      }
+    }
+    bail(cmd, _build_command(*node));
+    return cmd.execute(log_output, args.slice(depth));
+  }
+
+  bee::OrError<const sf::Node*> _find_child(
+    const sf::Node& group, const std::string_view& name) const
+  {
+    uint32_t low = group.first_child;
+    uint32_t high = group.first_child + group.num_children;
+    while (low < high) {
+      uint32_t mid = low + (high - low) / 2;
+      bail(child, _mapping->node(mid));
+      bail(child_name, _mapping->str(child->name));
+      if (child_name == name) { return child; }
+      if (child_name < name) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return nullptr;
+  }
+
+  bee::OrError<> _print_help(
+    const bee::LogOutput log_output, const sf::Node& group) const
+  {
+    std::vector<std::pair<std::string_view, std::string_view>> entries;
+    entries.emplace_back("help", "Prints this help");
+    for (uint32_t i = 0; i < group.num_children; i++) {
+      bail(child, _mapping->node(group.first_child + i));
+      bail(name, _mapping->str(child->name));
+      bail(description, _mapping->str(child->description));
+      entries.emplace_back(name, description);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    size_t longest_name = 0;
+    for (const auto& entry : entries) {
+      longest_name = std::max(longest_name, entry.first.size());
+    }
+    PF(log_output, "Available comands:");
+    for (const auto& entry : entries) {
+      PF(
+        log_output,
+        "  $  $",
+        bee::right_pad_string(std::string(entry.first), longest_name),
+        entry.second);
+    }
+    return bee::ok();
+  }
+
+  bee::OrError<Cmd> _build_command(const sf::Node& node) const
+  {
+    bail(handler_name, _mapping->str(node.handler));
+    auto handler = _handlers->find(handler_name);
+    if (handler == _handlers->end()) {
+      return bee::Error::fmt("No handler bound to '$'", handler_name);
+    }
+
+    bail(description, _mapping->str(node.description));
+    auto builder = CommandBuilder(description);
+    std::vector<collector_type> collectors;
+    for (uint32_t i = 0; i < node.num_flags; i++) {
+      const auto& flag = _mapping->flag(node.first_flag + i);
+      bail(name, _mapping->str(flag.name));
+      bail(doc_str, _mapping->str(flag.doc));
+      opt_strview doc;
+      if (!doc_str.empty()) { doc = doc_str; }
+      switch (flag.spec) {
+      case sf::SpecKind::None: {
+        if (flag.kind != sf::FlagKind::NoArg) {
+          return bee::Error::fmt("Flag $ has no spec", name);
+        }
+        auto value = builder.no_arg(name, doc);
+        collectors.push_back([value, key = std::string(name)](
+                               SchemaArgs& args) { args.set(key, *value); });
+      } break;
+      case sf::SpecKind::String:
+        bail_unit(
+          add_flag(builder, flag.kind, name, doc, flags::String, collectors));
+        break;
+      case sf::SpecKind::Int:
+        bail_unit(
+          add_flag(builder, flag.kind, name, doc, flags::Int, collectors));
+        break;
+      case sf::SpecKind::Float:
+        bail_unit(
+          add_flag(builder, flag.kind, name, doc, flags::Float, collectors));
+        break;
+      default:
+        return bee::Error::fmt("Flag $ has an unknown spec", name);
+      }
+    }
+
+    return builder.run(
+      [collectors = std::move(collectors),
+       handler = handler->second]() -> bee::OrError<> {
+        SchemaArgs args;
+        for (const auto& collect : collectors) { collect(args); }
+        return handler(args);
+      });
+  }
+
+  const std::string _path;
+  const std::shared_ptr<const Mapping> _mapping;
+  const std::shared_ptr<const SchemaHandlers> _handlers;
+};
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// SchemaArgs
+//
+
+void SchemaArgs::set(const std::string_view& name, Value&& value)
+{
+  _values.insert_or_assign(std::string(name), std::move(value));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// load_schema
+//
+
+bee::OrError<Cmd> load_schema(const std::string& path, SchemaHandlers handlers)
+{
+  bail(mapping, Mapping::open(path));
+  bail(root, mapping->node(0));
+  if (root->kind != sf::NodeKind::Group) {
+    return bee::Error::fmt("Schema '$' is corrupted", path);
+  }
+  bail(description, mapping->str(root->description));
+  return Cmd(std::make_shared<SchemaGroup>(
+    description,
+    path,
+    std::move(mapping),
+    std::make_shared<const SchemaHandlers>(std::move(handlers))));
+}
+
+} // namespace command
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "cmd.hpp"
+
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Values of the flags given to a command defined in a schema, keyed by flag
+// name, or by value name for anonymous flags. no_arg flags are always present.
+struct SchemaArgs {
+ public:
+  using Value = std::variant<
+    bool,
+    std::string,
+    int,
+    double,
+    std::vector<std::string>,
+    std::vector<int>,
+    std::vector<double>>;
+
+  // Returns nullptr if the flag wasn't given. Asking for a type other than the
+  // flag's is a programming error and throws std::logic_error.
+  template <class T> const T* get(const std::string_view& name) const
+  {
+    auto it = _values.find(name);
+    if (it == _values.end()) { return nullptr; }
+    auto value = std::get_if<T>(&it->second);
+    if (value == nullptr) {
+      throw std::logic_error(
+        "Schema flag " + std::string(name) + " accessed with the wrong type");
+    }
+    return value;
+  }
+
+  void set(const std::string_view& name, Value&& value);
+
+ private:
+  std::map<std::string, Value, std::less<>> _values;
+};
+
+using schema_handler_type = std::function<bee::OrError<>(const SchemaArgs&)>;
+using SchemaHandlers = std::map<std::string, schema_handler_type, std::less<>>;
+
+// Returns a command for the tree described by a schema compiled with
+// compile_schema, see schema_compiler.hpp. Commands run the handler bound to
+// their handler name.
+//
+// The file is mapped in memory and only the path taken by the arguments is
+// read, so the cost of loading and dispatching doesn't depend on the size of
+// the tree. Only the command that runs is built, with a CommandBuilder.
+bee::OrError<Cmd> load_schema(const std::string& path, SchemaHandlers handlers);
+
+} // namespace command
@@ -0,0 +1,243 @@
+#include "schema_compiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "schema_format.hpp"
+
+namespace command {
+namespace {
+
+namespace sf = schema_format;
+
+struct TextFlag {
+ public:
+  std::string name;
+  std::string doc;
+  sf::FlagKind kind;
+  sf::SpecKind spec;
+};
+
+struct TextNode {
+ public:
+  bool is_command = false;
+  std::string description;
+  std::string handler;
+  std::map<std::string, std::unique_ptr<TextNode>> children;
+  std::vector<TextFlag> flags;
+};
+
+std::string_view next_word(std::string_view& line)
+{
+  size_t begin = line.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    line = {};
+    return {};
+  }
+  line.remove_prefix(begin);
+  size_t end = std::min(line.find_first_of(" \t"), line.size());
+  auto word = line.substr(0, end);
+  line.remove_prefix(end);
+  return word;
+}
+
+std::string rest_of_line(std::string_view line)
+{
+  size_t begin = line.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) { return {}; }
+  return std::string(line.substr(begin));
+}
+
+bee::OrError<sf::FlagKind> parse_flag_kind(const std::string_view& kind)
+{
+  if (kind == "no_arg") { return sf::FlagKind::NoArg; }
+  if (kind == "optional") { return sf::FlagKind::Optional; }
+  if (kind == "required") { return sf::FlagKind::Required; }
+  if (kind == "anon") { return sf::FlagKind::Anon; }
+  if (kind == "required_anon") { return sf::FlagKind::RequiredAnon; }
+  if (kind == "repeated_anon") { return sf::FlagKind::RepeatedAnon; }
+  return bee::Error::fmt("Unknown flag kind '$'", kind);
+}
+
+bee::OrError<sf::SpecKind> parse_spec(const std::string_view& spec)
+{
+  if (spec == "string") { return sf::SpecKind::String; }
+  if (spec == "int") { return sf::SpecKind::Int; }
+  if (spec == "float") { return sf::SpecKind::Float; }
+  return bee::Error::fmt("Unknown flag spec '$'", spec);
+}
+
+// Finds the node at path, creating missing groups along the way.
+bee::OrError<TextNode*> find_node(TextNode& root, const std::string_view& path)
+{
+  if (path.empty()) { return bee::Error("Expected a path"); }
+  TextNode* node = &root;
+  for (size_t begin = 0; begin <= path.size();) {
+    size_t end = std::min(path.find('/', begin), path.size());
+    auto name = path.substr(begin, end - begin);
+    begin = end + 1;
+    if (name.empty()) {
+      return bee::Error::fmt("Empty subcommand name in '$'", path);
+    }
+    if (node->is_command) {
+      return bee::Error::fmt("'$' is below a command", path);
+    }
+    auto& child = node->children[std::string(name)];
+    if (child == nullptr) { child = std::make_unique<TextNode>(); }
+    node = child.get();
+  }
+  return node;
+}
+
+struct Writer {
+ public:
+  sf::String add_string(const std::string_view& str)
+  {
+    auto it = _string_offsets.find(std::string(str));
+    if (it != _string_offsets.end()) {
+      return {.offset = it->second, .size = uint32_t(str.size())};
+    }
+    uint32_t offset = _strings.size();
+    _strings += str;
+    _string_offsets.emplace(str, offset);
+    return {.offset = offset, .size = uint32_t(str.size())};
+  }
+
+  std::vector<sf::Node> nodes;
+  std::vector<sf::Flag> flags;
+
+  std::string finish() const
+  {
+    sf::Header header;
+    std::memcpy(header.magic, sf::magic, sizeof(header.magic));
+    header.version = sf::version;
+    header.num_nodes = nodes.size();
+    header.num_flags = flags.size();
+    header.strings_size = _strings.size();
+
+    std::string out;
+    out.reserve(
+      sizeof(header) + nodes.size() * sizeof(sf::Node) +
+      flags.size() * sizeof(sf::Flag) + _strings.size());
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(
+      reinterpret_cast<const char*>(nodes.data()),
+      nodes.size() * sizeof(sf::Node));
+    out.append(
+      reinterpret_cast<const char*>(flags.data()),
+      flags.size() * sizeof(sf::Flag));
+    out += _strings;
+    return out;
+  }
+
+ private:
+  std::string _strings;
+  std::unordered_map<std::string, uint32_t> _string_offsets;
+};
+
+bee::OrError<> parse_line(
+  std::string_view line, TextNode& root, TextNode*& last_command)
+{
+  auto keyword = next_word(line);
+  if (keyword == "root") {
+    root.description = rest_of_line(line);
+  } else if (keyword == "group") {
+    bail(node, find_node(root, next_word(line)));
+    if (node->is_command) { return bee::Error("Already declared as command"); }
+    node->description = rest_of_line(line);
+  } else if (keyword == "command") {
+    bail(node, find_node(root, next_word(line)));
+    if (node->is_command || !node->children.empty()) {
+      return bee::Error("Already declared");
+    }
+    auto handler = next_word(line);
+    if (handler.empty()) { return bee::Error("Expected a handler name"); }
+    node->is_command = true;
+    node->handler = handler;
+    node->description = rest_of_line(line);
+    last_command = node;
+  } else if (keyword == "flag") {
+    if (last_command == nullptr) {
+      return bee::Error("Flag declared before any command");
+    }
+    bail(kind, parse_flag_kind(next_word(line)));
+    auto name = next_word(line);
+    if (name.empty()) { return bee::Error("Expected a flag name"); }
+    auto spec = sf::SpecKind::None;
+    if (kind != sf::FlagKind::NoArg) {
+      bail(parsed, parse_spec(next_word(line)));
+      spec = parsed;
+    }
+    last_command->flags.push_back({
+      .name = std::string(name),
+      .doc = rest_of_line(line),
+      .kind = kind,
+      .spec = spec,
+    });
+  } else {
+    return bee::Error::fmt("Unknown declaration '$'", keyword);
+  }
+  return bee::ok();
+}
+
+} // namespace
+
+bee::OrError<std::string> compile_schema(const std::string_view& text)
+{
+  TextNode root;
+  TextNode* last_command = nullptr;
+  size_t line_number = 0;
+  for (size_t begin = 0; begin < text.size();) {
+    line_number++;
+    size_t end = std::min(text.find('\n', begin), text.size());
+    std::string_view line = text.substr(begin, end - begin);
+    begin = end + 1;
+    if (!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+    size_t first = line.find_first_not_of(" \t");
+    if (first == std::string_view::npos || line[first] == '#') { continue; }
+
+    auto err = parse_line(line, root, last_command);
+    if (err.is_error()) {
+      return bee::Error::fmt("Line $: $", line_number, err.error());
+    }
+  }
+
+  // Nodes are laid out breadth first, so the children of each group are
+  // contiguous, and in name order since they come from a map
+  Writer writer;
+  std::vector<const TextNode*> order = {&root};
+  std::vector<std::string_view> names = {""};
+  for (size_t i = 0; i < order.size(); i++) {
+    const TextNode& node = *order[i];
+    sf::Node out{
+      .name = writer.add_string(names[i]),
+      .description = writer.add_string(node.description),
+      .handler = writer.add_string(node.handler),
+      .kind = node.is_command ? sf::NodeKind::Command : sf::NodeKind::Group,
+      .first_child = uint32_t(order.size()),
+      .num_children = uint32_t(node.children.size()),
+      .first_flag = uint32_t(writer.flags.size()),
+      .num_flags = uint32_t(node.flags.size()),
+    };
+    writer.nodes.push_back(out);
+    for (const auto& [name, child] : node.children) {
+      order.push_back(child.get());
+      names.push_back(name);
+    }
+    for (const auto& flag : node.flags) {
+      writer.flags.push_back({
+        .name = writer.add_string(flag.name),
+        .doc = writer.add_string(flag.doc),
+        .kind = flag.kind,
+        .spec = flag.spec,
+      });
+    }
+  }
+  return writer.finish();
+}
+
+} // namespace command
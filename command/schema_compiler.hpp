@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "bee/or_error.hpp"
+
+namespace command {
+
+// Compiles the text description of a command tree into the binary schema read
+// by load_schema. The description has one declaration per line, blank lines
+// and lines starting with # are ignored:
+//
+//   root <description...>
+//   group <path> <description...>
+//   command <path> <handler> <description...>
+//   flag <kind> <name> <spec> <doc...>
+//
+// Paths are subcommand names separated by /, groups along a path that aren't
+// declared are created with no description. A flag belongs to the last
+// command declared. kind is one of no_arg, optional, required, anon,
+// required_anon or repeated_anon, and anonymous flags are named by their value
+// name. spec is one of string, int or float, and is omitted for no_arg flags.
+//
+//   root Manages deployments
+//   group config Configuration
+//   command config/show config_show Shows the configuration
+//   flag optional --format string Output format
+//   command deploy deploy Deploys a service
+//   flag no_arg --dry-run Prints what would be done
+//   flag required_anon service string Service to deploy
+bee::OrError<std::string> compile_schema(const std::string_view& text);
+
+} // namespace command
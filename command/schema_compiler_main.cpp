@@ -0,0 +1,67 @@
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "io_util.hpp"
+#include "schema_compiler.hpp"
+
+#include "bee/log_output.hpp"
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+
+// Compiles the text description of a command tree into a binary schema for
+// load_schema:
+//
+//   schema_compiler <input> <output>
+namespace {
+
+bee::OrError<> write_file(const std::string& path, const std::string& content)
+{
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    return bee::Error::fmt("Failed to open '$': $", path, strerror(errno));
+  }
+  for (size_t written = 0; written < content.size();) {
+    ssize_t n = write(fd, content.data() + written, content.size() - written);
+    if (n == -1) {
+      if (errno == EINTR) { continue; }
+      int err = errno;
+      close(fd);
+      return bee::Error::fmt("Failed to write '$': $", path, strerror(err));
+    }
+    written += n;
+  }
+  if (close(fd) != 0) {
+    return bee::Error::fmt("Failed to write '$': $", path, strerror(errno));
+  }
+  return bee::ok();
+}
+
+bee::OrError<> compile(const std::string& input, const std::string& output)
+{
+  bail(text, command::io_util::read_file(input));
+  auto schema = command::compile_schema(text);
+  if (schema.is_error()) {
+    return bee::Error::fmt("$: $", input, schema.error());
+  }
+  return write_file(output, *schema);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc != 3) {
+    PF(bee::LogOutput::StdErr, "Usage: $ <input> <output>", argv[0]);
+    return 2;
+  }
+  auto err = compile(argv[1], argv[2]);
+  if (err.is_error()) {
+    PF(bee::LogOutput::StdErr, "ERROR: $", err.error());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+namespace command::schema_format {
+
+// Layout of a compiled schema file, written by compile_schema and mapped by
+// load_schema. All integers are native endian 32 bit values:
+//
+//   Header | Node[num_nodes] | Flag[num_flags] | string bytes
+//
+// Node 0 is the root group. Nodes are laid out breadth first, so the children
+// of a group come after it, are contiguous and sorted by name, and the flags
+// of a command are contiguous, so the tree can be walked in place without
+// reading the parts that aren't used.
+
+constexpr char magic[4] = {'C', 'M', 'D', 'S'};
+constexpr uint32_t version = 1;
+
+struct String {
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_nodes;
+  uint32_t num_flags;
+  uint32_t strings_size;
+};
+
+enum class NodeKind : uint32_t {
+  Group = 0,
+  Command = 1,
+};
+
+struct Node {
+  String name;
+  String description;
+  // Name the handler is bound by, commands only
+  String handler;
+  NodeKind kind;
+  uint32_t first_child;
+  uint32_t num_children;
+  uint32_t first_flag;
+  uint32_t num_flags;
+};
+
+enum class FlagKind : uint32_t {
+  NoArg = 0,
+  Optional = 1,
+  Required = 2,
+  Anon = 3,
+  RequiredAnon = 4,
+  RepeatedAnon = 5,
+};
+
+enum class SpecKind : uint32_t {
+  None = 0,
+  String = 1,
+  Int = 2,
+  Float = 3,
+};
+
+struct Flag {
+  // The flag name, or the value name of anonymous flags
+  String name;
+  String doc;
+  FlagKind kind;
+  SpecKind spec;
+};
+
+} // namespace command::schema_format
@@ -0,0 +1,202 @@
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "command_base.hpp"
+#include "schema.hpp"
+#include "schema_compiler.hpp"
+#include "schema_format.hpp"
+
+#include "bee/format_vector.hpp"
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace command {
+namespace {
+
+constexpr char schema_path[] = "schema_test.bin";
+
+constexpr char description[] = R"(
+# Deployment tool
+root Manages deployments
+group config Configuration
+command config/show config_show Shows the configuration
+flag optional --format string Output format
+command config/set config_set Sets a value
+flag required_anon key string
+flag required_anon value int
+command deploy deploy Deploys services
+flag no_arg --dry-run Prints what would be done
+flag optional --timeout float Seconds to wait
+flag repeated_anon services string Services to deploy
+command rollback rollback Rolls back a deployment
+)";
+
+void save(const string& content)
+{
+  std::ofstream file(schema_path, std::ios::binary);
+  file << content;
+}
+
+void run_cmd(const vector<string_view>& args, const Cmd& cmd)
+{
+  P("args: $", vector<string>(args.begin(), args.end()));
+  int exit_code = cmd.execute(
+    bee::LogOutput::StdOut, bee::ArrayView<const string_view>(args));
+  P("exit_code=$", exit_code);
+  P("--------------------------------------------");
+}
+
+SchemaHandlers handlers()
+{
+  return {
+    {"config_show",
+     [](const SchemaArgs& args) {
+       auto format = args.get<string>("--format");
+       P("show format:$", format ? *format : "default");
+       return bee::ok();
+     }},
+    {"config_set",
+     [](const SchemaArgs& args) {
+       P("set $=$", *args.get<string>("key"), *args.get<int>("value"));
+       return bee::ok();
+     }},
+    {"deploy",
+     [](const SchemaArgs& args) -> bee::OrError<> {
+       auto timeout = args.get<double>("--timeout");
+       P("deploy dry_run:$ timeout:$ services:$",
+         *args.get<bool>("--dry-run"),
+         timeout ? *timeout : 0.0,
+         *args.get<vector<string>>("services"));
+       if (args.get<vector<string>>("services")->empty()) {
+         return bee::Error("Nothing to deploy");
+       }
+       return bee::ok();
+     }},
+  };
+}
+
+TEST(load)
+{
+  save(compile_schema(description).value());
+  auto cmd = load_schema(schema_path, handlers()).value();
+
+  run_cmd({"config", "show"}, cmd);
+  run_cmd({"config", "show", "--format", "json"}, cmd);
+  run_cmd({"config", "set", "retries", "3"}, cmd);
+  run_cmd({"config", "set", "retries", "many"}, cmd);
+  run_cmd({"deploy", "--dry-run", "--timeout", "2.5", "web", "db"}, cmd);
+  run_cmd({"deploy"}, cmd);
+  run_cmd({"deploy", "--help"}, cmd);
+  run_cmd({"config"}, cmd);
+  run_cmd({"help"}, cmd);
+  run_cmd({"nope"}, cmd);
+  run_cmd({"rollback"}, cmd);
+  unlink(schema_path);
+}
+
+TEST(errors)
+{
+  auto compile = [](const string_view& text) {
+    P(compile_schema(text).error());
+  };
+  compile("flag no_arg --verbose\n");
+  compile("command a a\nflag optional --x list\n");
+  compile("command a a\ncommand a/b b\n");
+  compile("group a\ncommand a a\ncommand a a\n");
+  compile("subcommand a\n");
+
+  auto load = [](const string& content) {
+    save(content);
+    P(load_schema(schema_path, {}).error());
+    unlink(schema_path);
+  };
+  auto schema = compile_schema(description).value();
+  load(schema.substr(0, schema.size() - 1));
+  load("not a schema, but long enough");
+  P(load_schema("no_such_schema.bin", {}).error());
+}
+
+TEST(corrupted)
+{
+  namespace sf = schema_format;
+  const auto schema = compile_schema(description).value();
+  sf::Header header;
+  memcpy(&header, schema.data(), sizeof(header));
+  const size_t nodes = sizeof(sf::Header);
+  const size_t flags = nodes + header.num_nodes * sizeof(sf::Node);
+
+  // Overwrites a 32 bit field of count nodes or flags
+  auto corrupt = [&](
+                   size_t begin,
+                   size_t count,
+                   size_t stride,
+                   size_t field,
+                   uint32_t value) {
+    auto out = schema;
+    for (size_t i = 0; i < count; i++) {
+      memcpy(out.data() + begin + i * stride + field, &value, sizeof(value));
+    }
+    return out;
+  };
+  const char* strings = schema.data() + schema.size() - header.strings_size;
+  size_t timeout = 0;
+  for (size_t i = 0; i < header.num_flags; i++) {
+    sf::Flag flag;
+    memcpy(&flag, schema.data() + flags + i * sizeof(flag), sizeof(flag));
+    string_view name(strings + flag.name.offset, flag.name.size);
+    if (name == "--timeout") {
+      timeout = flags + i * sizeof(flag);
+    }
+  }
+
+  P("Node kinds:");
+  save(corrupt(
+    nodes, header.num_nodes, sizeof(sf::Node), offsetof(sf::Node, kind), 7));
+  P(load_schema(schema_path, handlers()).error());
+  P("Root group pointing at itself:");
+  save(corrupt(nodes, 1, sizeof(sf::Node), offsetof(sf::Node, first_child), 0));
+  P(load_schema(schema_path, handlers()).error());
+
+  auto run_corrupted = [&](const string& content) {
+    save(content);
+    run_cmd(
+      {"deploy", "web"}, load_schema(schema_path, handlers()).value());
+  };
+  P("Flag kind:");
+  run_corrupted(
+    corrupt(timeout, 1, sizeof(sf::Flag), offsetof(sf::Flag, kind), 7));
+  P("Flag with a spec but no value:");
+  run_corrupted(
+    corrupt(timeout, 1, sizeof(sf::Flag), offsetof(sf::Flag, kind), 0));
+  P("Flag spec:");
+  run_corrupted(
+    corrupt(timeout, 1, sizeof(sf::Flag), offsetof(sf::Flag, spec), 7));
+
+  // Node 1 is the config group, the first child of the root
+  P("Group pointing at itself:");
+  save(corrupt(
+    nodes + sizeof(sf::Node),
+    1,
+    sizeof(sf::Node),
+    offsetof(sf::Node, first_child),
+    1));
+  auto cmd = load_schema(schema_path, handlers()).value();
+  run_cmd({"config", "show"}, cmd);
+  CompletionTree tree;
+  cmd.base()->describe(tree);
+  P("Completed subcommands: $", tree.subcommands.size());
+  unlink(schema_path);
+}
+
+} // namespace
+} // namespace command
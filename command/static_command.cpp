@@ -0,0 +1,20 @@
+#include "static_command.hpp"
+
+#include "bee/print.hpp"
+
+namespace command {
+namespace details {
+
+int report_static_parse_error(
+  const bee::LogOutput log_output,
+  const bee::Error& error,
+  const std::vector<FlagDoc>& docs)
+{
+  CommandBase::record_error(error);
+  PF(log_output, "ERROR: $\n", error);
+  print_flag_docs(log_output, docs);
+  return 1;
+}
+
+} // namespace details
+} // namespace command
@@ -0,0 +1,517 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cmd.hpp"
+#include "command_base.hpp"
+#include "command_flags.hpp"
+#include "flag_spec.hpp"
+#include "response_file.hpp"
+
+#include "bee/array_view.hpp"
+#include "bee/log_output.hpp"
+#include "bee/or_error.hpp"
+
+// Commands whose flags are declared at compile time. The flag names, kinds and
+// specs are template parameters, so the parser is generated as a chain of
+// direct comparisons and the parsed values live in a single tuple on the
+// stack. There are no virtual calls and no heap allocated flag objects
+// involved in parsing.
+//
+// Flag names only match exactly. Unlike commands built with CommandBuilder,
+// unambiguous prefixes (e.g. --verb for --verbose) are rejected as unknown
+// flags, so switching a command to a static one can break callers that
+// abbreviate.
+//
+// Example:
+//
+//   namespace sf = command::static_flags;
+//   auto cmd = command::StaticCommandBuilder(
+//                "Sub command",
+//                sf::optional<"--name">(flags::String),
+//                sf::optional_with_default<"--count">(flags::Int, 1),
+//                sf::no_arg<"--verbose">(),
+//                sf::required_anon<"file">(flags::String))
+//                .run([](const auto& args) -> bee::OrError<> {
+//                  P(command::get<"file">(args));
+//                  return bee::ok();
+//                });
+
+namespace command {
+
+template <size_t N> struct FlagName {
+ public:
+  constexpr FlagName(const char (&str)[N]) { std::copy_n(str, N, data); }
+
+  constexpr std::string_view view() const { return {data, N - 1}; }
+
+  char data[N];
+};
+
+enum class StaticFlagKind {
+  Optional,
+  Required,
+  NoArg,
+  Anon,
+  RequiredAnon,
+  RepeatedAnon,
+};
+
+struct NoArgSpec {
+  using value_type = bool;
+};
+
+template <FlagName Name, StaticFlagKind Kind, class S> struct StaticFlag {
+ public:
+  using spec_type = S;
+  using value_type = typename S::value_type;
+  using storage_type = std::conditional_t<
+    Kind == StaticFlagKind::NoArg,
+    bool,
+    std::conditional_t<
+      Kind == StaticFlagKind::RepeatedAnon,
+      std::vector<value_type>,
+      std::optional<value_type>>>;
+
+  static constexpr std::string_view name = Name.view();
+  static constexpr StaticFlagKind kind = Kind;
+  static constexpr bool is_anon = Kind == StaticFlagKind::Anon ||
+                                  Kind == StaticFlagKind::RequiredAnon ||
+                                  Kind == StaticFlagKind::RepeatedAnon;
+  static constexpr bool is_required =
+    Kind == StaticFlagKind::Required || Kind == StaticFlagKind::RequiredAnon;
+
+  S spec;
+  std::optional<value_type> def;
+  opt_strview value_name;
+  opt_strview doc;
+};
+
+namespace static_flags {
+
+template <FlagName Name, FlagSpec S>
+auto optional(
+  const S& spec,
+  const opt_strview& value_name = std::nullopt,
+  const opt_strview& doc = std::nullopt)
+{
+  return StaticFlag<Name, StaticFlagKind::Optional, S>{
+    .spec = spec, .def = std::nullopt, .value_name = value_name, .doc = doc};
+}
+
+template <FlagName Name, FlagSpec S>
+auto optional_with_default(
+  const S& spec,
+  const typename S::value_type& def,
+  const opt_strview& value_name = std::nullopt,
+  const opt_strview& doc = std::nullopt)
+{
+  return StaticFlag<Name, StaticFlagKind::Required, S>{
+    .spec = spec, .def = def, .value_name = value_name, .doc = doc};
+}
+
+template <FlagName Name, FlagSpec S>
+auto required(
+  const S& spec,
+  const opt_strview& value_name = std::nullopt,
+  const opt_strview& doc = std::nullopt)
+{
+  return StaticFlag<Name, StaticFlagKind::Required, S>{
+    .spec = spec, .def = std::nullopt, .value_name = value_name, .doc = doc};
+}
+
+template <FlagName Name> auto no_arg(const opt_strview& doc = std::nullopt)
+{
+  return StaticFlag<Name, StaticFlagKind::NoArg, NoArgSpec>{
+    .spec = {}, .def = std::nullopt, .value_name = std::nullopt, .doc = doc};
+}
+
+// For anonymous flags the name is only used to look up the value and as the
+// value name shown in the help.
+template <FlagName Name, FlagSpec S>
+auto anon(const S& spec, const opt_strview& doc = std::nullopt)
+{
+  return StaticFlag<Name, StaticFlagKind::Anon, S>{
+    .spec = spec, .def = std::nullopt, .value_name = Name.view(), .doc = doc};
+}
+
+template <FlagName Name, FlagSpec S>
+auto required_anon(const S& spec, const opt_strview& doc = std::nullopt)
+{
+  return StaticFlag<Name, StaticFlagKind::RequiredAnon, S>{
+    .spec = spec, .def = std::nullopt, .value_name = Name.view(), .doc = doc};
+}
+
+template <FlagName Name, FlagSpec S>
+auto repeated_anon(const S& spec, const opt_strview& doc = std::nullopt)
+{
+  return StaticFlag<Name, StaticFlagKind::RepeatedAnon, S>{
+    .spec = spec, .def = std::nullopt, .value_name = Name.view(), .doc = doc};
+}
+
+} // namespace static_flags
+
+namespace details {
+
+template <FlagName Name, class... Flags> constexpr size_t static_flag_index()
+{
+  constexpr std::string_view names[] = {Flags::name..., ""};
+  for (size_t i = 0; i < sizeof...(Flags); i++) {
+    if (names[i] == Name.view()) { return i; }
+  }
+  return sizeof...(Flags);
+}
+
+template <class... Flags> constexpr bool static_flags_are_valid()
+{
+  constexpr std::string_view names[] = {Flags::name..., ""};
+  constexpr bool anon[] = {Flags::is_anon..., false};
+  constexpr bool repeated[] = {
+    (Flags::kind == StaticFlagKind::RepeatedAnon)..., false};
+  bool seen_repeated = false;
+  for (size_t i = 0; i < sizeof...(Flags); i++) {
+    if (names[i] == "--help") { return false; }
+    for (size_t j = 0; j < i; j++) {
+      if (names[i] == names[j]) { return false; }
+    }
+    if (anon[i] && seen_repeated) { return false; }
+    seen_repeated = seen_repeated || repeated[i];
+  }
+  return true;
+}
+
+int report_static_parse_error(
+  bee::LogOutput log_output,
+  const bee::Error& error,
+  const std::vector<FlagDoc>& docs);
+
+} // namespace details
+
+template <class... Flags> struct StaticValues {
+ public:
+  std::tuple<typename Flags::storage_type...> values;
+};
+
+// Returns the parsed value of the flag with the given name. Optional flags
+// yield a std::optional, required flags and flags with defaults yield the
+// value itself, no_arg flags yield a bool and repeated flags a vector.
+template <FlagName Name, class... Flags>
+const auto& get(const StaticValues<Flags...>& values)
+{
+  constexpr size_t index = details::static_flag_index<Name, Flags...>();
+  static_assert(index < sizeof...(Flags), "No flag with the given name");
+  using flag_type = std::tuple_element_t<index, std::tuple<Flags...>>;
+  const auto& value = std::get<index>(values.values);
+  if constexpr (flag_type::is_required) {
+    return *value;
+  } else {
+    return value;
+  }
+}
+
+template <class H, class... Flags>
+struct StaticCommand final : public CommandBase {
+ public:
+  using values_type = StaticValues<Flags...>;
+
+  StaticCommand(
+    const std::string_view& description,
+    std::tuple<Flags...> flags,
+    bool response_files,
+    H handler)
+      : CommandBase(description),
+        _flags(std::move(flags)),
+        _response_files(response_files),
+        _handler(std::move(handler))
+  {}
+
+  virtual ~StaticCommand() {}
+
+  virtual int execute(
+    const bee::LogOutput log_output,
+    const bee::ArrayView<const std::string_view> args) const override
+  {
+    values_type values;
+    _set_defaults(values, std::index_sequence_for<Flags...>());
+
+    bool show_help = false;
+    ExpandedArgs expanded;
+    auto err = _expand_and_parse(args, expanded, values, show_help);
+    if (show_help) {
+      print_flag_docs(log_output, _make_docs());
+      return 0;
+    }
+    if (err.is_error()) {
+      return details::report_static_parse_error(
+        log_output, err.error(), _make_docs());
+    }
+
+    return run_handler(log_output, [&]() { return _handler(values); });
+  }
+
+ private:
+  template <size_t I>
+  using flag_type = std::tuple_element_t<I, std::tuple<Flags...>>;
+
+  template <size_t I> static constexpr size_t anon_position()
+  {
+    constexpr bool anon[] = {Flags::is_anon..., false};
+    size_t pos = 0;
+    for (size_t i = 0; i < I; i++) { pos += anon[i]; }
+    return pos;
+  }
+
+  template <size_t... I>
+  void _set_defaults(values_type& values, std::index_sequence<I...>) const
+  {
+    ((std::get<I>(values.values) = _default<I>()), ...);
+  }
+
+  template <size_t I> auto _default() const
+  {
+    using F = flag_type<I>;
+    if constexpr (F::kind == StaticFlagKind::NoArg) {
+      return false;
+    } else if constexpr (F::kind == StaticFlagKind::RepeatedAnon) {
+      return typename F::storage_type();
+    } else {
+      return std::get<I>(_flags).def;
+    }
+  }
+
+  bee::OrError<> _expand_and_parse(
+    const bee::ArrayView<const std::string_view>& args,
+    ExpandedArgs& expanded,
+    values_type& values,
+    bool& show_help) const
+  {
+    if (_response_files && has_response_files(args)) {
+      bail_unit(expand_response_files(args, expanded));
+      return _parse(expanded.view(), values, show_help);
+    }
+    return _parse(args, values, show_help);
+  }
+
+  bee::OrError<> _parse(
+    const bee::ArrayView<const std::string_view>& args,
+    values_type& values,
+    bool& show_help) const
+  {
+    size_t anon_index = 0;
+    bool flag_escaped = false;
+    for (size_t i = 0; i < args.size();) {
+      const std::string_view& arg = args.at(i++);
+      if (arg.size() > 1 && arg.front() == '-' && !flag_escaped) {
+        if (arg == "--") {
+          flag_escaped = true;
+          continue;
+        }
+        auto eq = arg.find('=');
+        auto name = arg.substr(0, eq);
+        if (name == "--help") {
+          show_help = true;
+          continue;
+        }
+        std::optional<std::string_view> value;
+        if (eq != std::string_view::npos) { value = arg.substr(eq + 1); }
+        bail_unit(_parse_named<0>(name, value, args, i, values));
+      } else {
+        bail_unit(_parse_anon<0>(arg, anon_index, values));
+      }
+    }
+    return _finish<0>(values);
+  }
+
+  template <size_t I>
+  bee::OrError<> _parse_named(
+    const std::string_view& name,
+    const std::optional<std::string_view>& inline_value,
+    const bee::ArrayView<const std::string_view>& args,
+    size_t& i,
+    values_type& values) const
+  {
+    if constexpr (I == sizeof...(Flags)) {
+      return bee::Error::fmt("Unknown flag '$'", name);
+    } else {
+      using F = flag_type<I>;
+      if constexpr (!F::is_anon) {
+        if (name == F::name) {
+          if constexpr (F::kind == StaticFlagKind::NoArg) {
+            if (inline_value.has_value()) {
+              return bee::Error::fmt("Flag $ does not take a value", name);
+            }
+            std::get<I>(values.values) = true;
+            return bee::ok();
+          } else {
+            std::string_view value;
+            if (inline_value.has_value()) {
+              value = *inline_value;
+            } else if (i < args.size()) {
+              value = args.at(i++);
+            } else {
+              return bee::Error::fmt("No arguments for flag $", name);
+            }
+            auto parsed = std::get<I>(_flags).spec.of_string(value);
+            if (parsed.is_error()) {
+              return bee::Error::fmt(
+                "Failed to parse flag $ with value '$': $",
+                name,
+                value,
+                parsed.error());
+            }
+            std::get<I>(values.values).emplace(std::move(parsed.value()));
+            return bee::ok();
+          }
+        }
+      }
+      return _parse_named<I + 1>(name, inline_value, args, i, values);
+    }
+  }
+
+  template <size_t I>
+  bee::OrError<> _parse_anon(
+    const std::string_view& value, size_t& anon_index, values_type& values)
+    const
+  {
+    if constexpr (I == sizeof...(Flags)) {
+      return bee::Error::fmt("Unexpected anonymous argument '$'", value);
+    } else {
+      using F = flag_type<I>;
+      if constexpr (F::is_anon) {
+        if (anon_index == anon_position<I>()) {
+          auto parsed = std::get<I>(_flags).spec.of_string(value);
+          if (parsed.is_error()) {
+            return bee::Error::fmt(
+              "Failed to parse anon flag with value '$': $",
+              value,
+              parsed.error());
+          }
+          if constexpr (F::kind == StaticFlagKind::RepeatedAnon) {
+            std::get<I>(values.values).push_back(std::move(parsed.value()));
+          } else {
+            std::get<I>(values.values).emplace(std::move(parsed.value()));
+            anon_index++;
+          }
+          return bee::ok();
+        }
+      }
+      return _parse_anon<I + 1>(value, anon_index, values);
+    }
+  }
+
+  template <size_t I> bee::OrError<> _finish(const values_type& values) const
+  {
+    if constexpr (I == sizeof...(Flags)) {
+      return bee::ok();
+    } else {
+      using F = flag_type<I>;
+      if constexpr (F::is_required) {
+        if (!std::get<I>(values.values).has_value()) {
+          if constexpr (F::is_anon) {
+            return bee::Error::fmt(
+              "Anon flag <$> is required, but not provided", F::name);
+          } else {
+            return bee::Error::fmt(
+              "Flag $ is required, but not provided", F::name);
+          }
+        }
+      }
+      return _finish<I + 1>(values);
+    }
+  }
+
+  std::vector<FlagDoc> _make_docs() const
+  {
+    std::vector<FlagDoc> docs;
+    auto add_docs = [&](auto pred) {
+      std::apply(
+        [&](const auto&... flag) { (_add_doc(docs, flag, pred), ...); },
+        _flags);
+    };
+    add_docs([](bool anon, bool) { return anon; });
+    add_docs([](bool anon, bool required) { return !anon && required; });
+    add_docs([](bool anon, bool required) { return !anon && !required; });
+    docs.push_back(make_boolean_flag_doc("--help", "Displays this help"));
+    return docs;
+  }
+
+  template <FlagName Name, StaticFlagKind Kind, class S, class P>
+  static void _add_doc(
+    std::vector<FlagDoc>& docs,
+    const StaticFlag<Name, Kind, S>& flag,
+    const P& pred)
+  {
+    using F = StaticFlag<Name, Kind, S>;
+    const bool required = F::is_required && !flag.def.has_value();
+    if (!pred(F::is_anon, required)) { return; }
+    auto to_opt_str = [](const opt_strview& str) -> opt_str {
+      if (!str.has_value()) { return std::nullopt; }
+      return std::string(*str);
+    };
+    if constexpr (F::is_anon) {
+      docs.push_back(make_anon_flag_doc(
+        to_opt_str(flag.value_name),
+        to_opt_str(flag.doc),
+        F::is_required,
+        Kind == StaticFlagKind::RepeatedAnon));
+    } else if constexpr (Kind == StaticFlagKind::NoArg) {
+      docs.push_back(make_boolean_flag_doc(F::name, to_opt_str(flag.doc)));
+    } else {
+      opt_str def;
+      if (flag.def.has_value()) { def = flag.spec.to_string(*flag.def); }
+      docs.push_back(make_value_flag_doc(
+        F::name,
+        to_opt_str(flag.value_name),
+        to_opt_str(flag.doc),
+        required,
+        def));
+    }
+  }
+
+  std::tuple<Flags...> _flags;
+  bool _response_files;
+  H _handler;
+};
+
+template <class... Flags> struct StaticCommandBuilder {
+ public:
+  static_assert(
+    details::static_flags_are_valid<Flags...>(),
+    "Flag names must be unique and not --help, and a repeated anon flag "
+    "must be the last anon flag");
+
+  using values_type = StaticValues<Flags...>;
+
+  StaticCommandBuilder(const std::string_view& description, Flags... flags)
+      : _description(description), _flags(std::move(flags)...)
+  {}
+
+  // Expands @path arguments, see CommandBuilder::response_files.
+  StaticCommandBuilder& response_files()
+  {
+    _response_files = true;
+    return *this;
+  }
+
+  template <class H>
+    requires std::is_invocable_r_v<bee::OrError<>, H, const values_type&>
+  Cmd run(H handler) const
+  {
+    return Cmd(std::make_shared<StaticCommand<H, Flags...>>(
+      _description, _flags, _response_files, std::move(handler)));
+  }
+
+ private:
+  std::string _description;
+  std::tuple<Flags...> _flags;
+  bool _response_files = false;
+};
+
+} // namespace command
@@ -0,0 +1,138 @@
+#include "static_command.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+#include "bee/format_optional.hpp"
+#include "bee/format_vector.hpp"
+#include "bee/or_error.hpp"
+#include "bee/print.hpp"
+#include "bee/testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace command {
+namespace {
+
+namespace sf = static_flags;
+
+void run_command(const vector<string>& args, const Cmd& cmd)
+{
+  static const std::string binary = "binary";
+  vector<const char*> argv = {binary.data()};
+  for (auto& el : args) { argv.push_back(el.data()); }
+
+  int output = cmd.main(argv.size(), argv.data(), bee::LogOutput::StdOut);
+  P("exit_code=$", output);
+}
+
+TEST(args)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto cmd = StaticCommandBuilder(
+                 "Sub command",
+                 sf::optional<"--str">(flags::String),
+                 sf::optional<"--int">(flags::Int),
+                 sf::no_arg<"--bool">(),
+                 sf::anon<"asflag">(flags::String),
+                 sf::anon<"aiflag">(flags::Int))
+                 .run([](const auto& args) {
+                   P(get<"--str">(args));
+                   P(get<"--int">(args));
+                   P(get<"--bool">(args));
+                   P(get<"asflag">(args));
+                   P(get<"aiflag">(args));
+                   return bee::ok();
+                 });
+    run_command(std::move(args), cmd);
+    P("");
+  };
+
+  run_test({});
+  run_test({"--help"});
+  run_test({"--str", "string"});
+  run_test({"--int=123"});
+  run_test({"--bool"});
+  run_test({"--str"});
+  run_test({"--int", "abc"});
+  run_test({"--bool=1"});
+  run_test({"--bool", "--int", "123", "--str", "yo"});
+  run_test({"anon", "123"});
+  run_test({"anon", "123", "extra"});
+}
+
+TEST(required_and_default)
+{
+  int test_count = 1;
+
+  auto run_test = [&](vector<string> args) {
+    P("test $", test_count++);
+    P("args: '$'", args);
+    auto cmd =
+      StaticCommandBuilder(
+        "Sub command",
+        sf::optional_with_default<"--flag">(flags::String, "foobar"),
+        sf::required<"--filename">(flags::String, "file", "Input file"),
+        sf::required_anon<"rflag">(flags::Int),
+        sf::repeated_anon<"rest">(flags::String))
+        .run([](const auto& args) {
+          P("flag:$ filename:$ rflag:$ rest:$",
+            get<"--flag">(args),
+            get<"--filename">(args),
+            get<"rflag">(args),
+            get<"rest">(args));
+          return bee::ok();
+        });
+    run_command(std::move(args), cmd);
+    P("------------------------------------");
+  };
+
+  run_test({});
+  run_test({"--help"});
+  run_test({"--filename", "a.txt"});
+  run_test({"--filename", "a.txt", "10"});
+  run_test({"--filename", "a.txt", "--flag", "x", "10", "b", "c"});
+  run_test({"--filename", "a.txt", "10", "--", "--b", "-c"});
+  run_test({"--unknown"});
+}
+
+TEST(response_files)
+{
+  std::ofstream("static_command_response") << "--str\nfrom file\n";
+  auto run_test = [&](bool response_files, vector<string> args) {
+    P("args: '$'", args);
+    auto builder = StaticCommandBuilder(
+      "Sub command",
+      sf::optional<"--str">(flags::String),
+      sf::anon<"asflag">(flags::String));
+    if (response_files) { builder.response_files(); }
+    auto cmd = builder.run([](const auto& args) {
+      P(get<"--str">(args));
+      P(get<"asflag">(args));
+      return bee::ok();
+    });
+    run_command(std::move(args), cmd);
+    P("");
+  };
+
+  run_test(false, {"--str", "@static_command_response", "@@x"});
+  run_test(true, {"@static_command_response", "@@x"});
+  std::filesystem::remove("static_command_response");
+}
+
+TEST(exception)
+{
+  auto cmd = StaticCommandBuilder("Sub command").run([](const auto&) {
+    throw bee::Exn(bee::Location("filename.cpp", 10), "Failed");
+    return bee::ok();
+  });
+  run_command({}, cmd);
+}
+
+} // namespace
+} // namespace command